@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "apsp.h"
+
+typedef struct {
+    distance_t* dist;
+    size_t n;
+    size_t blocks;
+    size_t threads;
+    size_t id;
+    pthread_barrier_t* barrier;
+} apsp_worker_t;
+
+// Relaxes tile (bi, bj) through every intermediate node of tile bk
+static void apsp_relax_tile(distance_t* dist, size_t n, size_t bi, size_t bj, size_t bk)
+{
+    size_t i_end = (bi + 1) * APSP_BLOCK < n ? (bi + 1) * APSP_BLOCK : n;
+    size_t j_begin = bj * APSP_BLOCK;
+    size_t j_end = (bj + 1) * APSP_BLOCK < n ? (bj + 1) * APSP_BLOCK : n;
+    size_t k_end = (bk + 1) * APSP_BLOCK < n ? (bk + 1) * APSP_BLOCK : n;
+    for (size_t k = bk * APSP_BLOCK; k < k_end; k++) {
+        const distance_t* through_row = &dist[k * n + j_begin];
+        for (size_t i = bi * APSP_BLOCK; i < i_end; i++) {
+            // relaxing row k through itself can never improve it (dist[k][k] >= 0)
+            if (i == k) {
+                continue;
+            }
+            distance_min_plus(&dist[i * n + j_begin], through_row, dist[i * n + k], j_end - j_begin);
+        }
+    }
+}
+
+// Runs every round of the blocked algorithm, relaxing the tiles of each phase with index
+// congruent to the worker id; tiles within a phase are independent, so the schedule does
+// not change the result
+static void* apsp_worker(void* arg)
+{
+    apsp_worker_t* worker = arg;
+    size_t blocks = worker->blocks;
+    size_t others = blocks - 1;
+    for (size_t k = 0; k < blocks; k++) {
+        // phase 1: the diagonal tile only depends on itself
+        if (worker->id == 0) {
+            apsp_relax_tile(worker->dist, worker->n, k, k, k);
+        }
+        pthread_barrier_wait(worker->barrier);
+        // phase 2: tiles in row k and column k depend on themselves and the diagonal tile
+        for (size_t t = worker->id; t < 2 * others; t += worker->threads) {
+            size_t b = t / 2;
+            b += (b >= k);
+            if (t % 2 == 0) {
+                apsp_relax_tile(worker->dist, worker->n, k, b, k);
+            } else {
+                apsp_relax_tile(worker->dist, worker->n, b, k, k);
+            }
+        }
+        pthread_barrier_wait(worker->barrier);
+        // phase 3: every remaining tile only depends on its row-k and column-k tiles
+        for (size_t t = worker->id; t < others * others; t += worker->threads) {
+            size_t bi = t / others;
+            size_t bj = t % others;
+            bi += (bi >= k);
+            bj += (bj >= k);
+            apsp_relax_tile(worker->dist, worker->n, bi, bj, k);
+        }
+        pthread_barrier_wait(worker->barrier);
+    }
+    return NULL;
+}
+
+void apsp_solve_threads(distance_t* solution, const distance_t* topology, size_t n, size_t threads)
+{
+    if (solution != topology) {
+        memcpy(solution, topology, sizeof(distance_t) * n * n);
+    }
+    size_t blocks = (n + APSP_BLOCK - 1) / APSP_BLOCK;
+    if (blocks == 0) {
+        return;
+    }
+    // phase 3 has the most work, more threads than its tiles would only wait at the barriers
+    size_t max_threads = (blocks - 1) * (blocks - 1);
+    if (threads > max_threads) {
+        threads = max_threads;
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    pthread_barrier_t barrier;
+    int pthread_status = pthread_barrier_init(&barrier, NULL, (unsigned int)threads);
+    assert(pthread_status == 0);
+    apsp_worker_t* workers = malloc(sizeof(apsp_worker_t) * threads);
+    assert(workers != NULL);
+    pthread_t* pid = malloc(sizeof(pthread_t) * threads);
+    assert(pid != NULL);
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].dist = solution;
+        workers[i].n = n;
+        workers[i].blocks = blocks;
+        workers[i].threads = threads;
+        workers[i].id = i;
+        workers[i].barrier = &barrier;
+    }
+    for (size_t i = 1; i < threads; i++) {
+        pthread_status = pthread_create(&pid[i], NULL, apsp_worker, &workers[i]);
+        assert(pthread_status == 0);
+    }
+    // the caller is worker 0
+    apsp_worker(&workers[0]);
+    for (size_t i = 1; i < threads; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    free(pid);
+    free(workers);
+}
+
+void apsp_solve(distance_t* solution, const distance_t* topology, size_t n)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    apsp_solve_threads(solution, topology, n, cpus > 0 ? (size_t)cpus : 1);
+}
+
+typedef struct {
+    distance_t dist;
+    uint32_t node;
+} apsp_heap_entry_t;
+
+static void apsp_heap_push(apsp_heap_entry_t* heap, size_t* count, distance_t dist, size_t node)
+{
+    size_t i = (*count)++;
+    while (i > 0 && heap[(i - 1) / 2].dist > dist) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].dist = dist;
+    heap[i].node = (uint32_t)node;
+}
+
+static apsp_heap_entry_t apsp_heap_pop(apsp_heap_entry_t* heap, size_t* count)
+{
+    apsp_heap_entry_t top = heap[0];
+    apsp_heap_entry_t last = heap[--(*count)];
+    size_t i = 0;
+    while (2 * i + 1 < *count) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < *count && heap[child + 1].dist < heap[child].dist) {
+            child++;
+        }
+        if (heap[child].dist >= last.dist) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+// Single-source shortest paths from src into row; the heap has room for every link plus one
+// row[src] is the cheapest cycle back to src (or its self link), as in the Floyd-Warshall solution
+static void apsp_dijkstra(const topology_csr_t* links, size_t src, distance_t* row, apsp_heap_entry_t* heap)
+{
+    for (size_t i = 0; i < links->n; i++) {
+        row[i] = inf_distance;
+    }
+    row[src] = 0;
+    distance_t cycle = inf_distance;
+    size_t count = 0;
+    apsp_heap_push(heap, &count, 0, src);
+    while (count > 0) {
+        apsp_heap_entry_t entry = apsp_heap_pop(heap, &count);
+        if (entry.dist > row[entry.node]) {
+            // stale entry, the node was reached more cheaply since
+            continue;
+        }
+        for (size_t e = links->offsets[entry.node]; e < links->offsets[entry.node + 1]; e++) {
+            size_t next = links->neighbors[e];
+            if (links->weights[e] == inf_distance) {
+                continue;
+            }
+            distance_t candidate = entry.dist + links->weights[e];
+            if (next == src) {
+                cycle = (candidate < cycle) ? candidate : cycle;
+            } else if (candidate < row[next]) {
+                row[next] = candidate;
+                apsp_heap_push(heap, &count, candidate, next);
+            }
+        }
+    }
+    row[src] = cycle;
+}
+
+size_t apsp_update_link(distance_t* solution, const topology_csr_t* links, size_t src, size_t dst,
+                        distance_t old_weight, bool* changed_rows)
+{
+    size_t n = links->n;
+    distance_t weight = topology_csr_weight(links, src, dst);
+    size_t changed = 0;
+    for (size_t i = 0; i < n; i++) {
+        changed_rows[i] = false;
+    }
+    if (weight == old_weight) {
+        return 0;
+    }
+    if (weight < old_weight) {
+        // every path can now take the cheaper link: row i relaxes through dist(i, src) + weight + row dst
+        // (the diagonal holds cheapest cycles, so the distance of a router to itself is taken as 0)
+        for (size_t i = 0; i < n; i++) {
+            distance_t to_src = (i == src) ? 0 : solution[i * n + src];
+            // row dst only gains a cheaper cycle, which is handled last so the rows never overlap
+            if (i == dst || to_src == inf_distance) {
+                continue;
+            }
+            distance_t through = to_src + weight;
+            bool improved = distance_merge(solution + i * n, solution + dst * n, through, n);
+            if (through < solution[i * n + dst]) {
+                solution[i * n + dst] = through;
+                improved = true;
+            }
+            if (improved) {
+                changed_rows[i] = true;
+                changed++;
+            }
+        }
+        distance_t to_src = solution[dst * n + src];
+        if (to_src != inf_distance && to_src + weight < solution[dst * n + dst]) {
+            solution[dst * n + dst] = to_src + weight;
+            changed_rows[dst] = true;
+            changed++;
+        }
+        return changed;
+    }
+    // only sources whose distance to dst was achieved through the link can get worse
+    apsp_heap_entry_t* heap = malloc(sizeof(apsp_heap_entry_t) * (links->edges + 1));
+    distance_t* row = malloc(sizeof(distance_t) * n);
+    assert(heap != NULL && row != NULL);
+    for (size_t i = 0; i < n; i++) {
+        distance_t to_src = (i == src) ? 0 : solution[i * n + src];
+        if (to_src != inf_distance && old_weight != inf_distance && to_src + old_weight == solution[i * n + dst]) {
+            apsp_dijkstra(links, i, row, heap);
+            if (distance_copy(solution + i * n, row, n)) {
+                changed_rows[i] = true;
+                changed++;
+            }
+        }
+    }
+    free(heap);
+    free(row);
+    return changed;
+}
@@ -0,0 +1,31 @@
+#ifndef APSP_H
+#define APSP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "distance.h"
+#include "topology.h"
+
+// Side of the square tiles used by the blocked Floyd-Warshall solver
+// Three 64x64 tiles of distance_t (48KB) stay resident in L1/L2 while a tile is relaxed
+#define APSP_BLOCK 64
+
+// Computes all-pairs shortest paths of the n x n row-major matrix topology into solution
+// Uses the three-phase blocked Floyd-Warshall scheme (diagonal tile, its row and column, then the rest)
+// with one thread per online CPU
+// solution and topology may be the same matrix to solve in place
+void apsp_solve(distance_t* solution, const distance_t* topology, size_t n);
+
+// Same as apsp_solve but spreads the tiles of each phase over the given number of threads
+// (including the caller); the result does not depend on the thread count
+void apsp_solve_threads(distance_t* solution, const distance_t* topology, size_t n, size_t threads);
+
+// Updates solution (solved for links before the change) after the weight of the link src -> dst
+// changed from old_weight to the weight links now holds, without solving from scratch:
+// a cheaper link relaxes every row through it, a dearer (or failed) link re-solves only the rows
+// of sources whose shortest paths could have used it with Dijkstra over the CSR links
+// Rows that changed are flagged in changed_rows (n entries); returns the number of changed rows
+size_t apsp_update_link(distance_t* solution, const topology_csr_t* links, size_t src, size_t dst,
+                        distance_t old_weight, bool* changed_rows);
+
+#endif // APSP_H
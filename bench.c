@@ -0,0 +1,509 @@
+#include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "channel.h"
+
+// Microbenchmarks of the channel API: every case runs its warm-up repetitions, then its measured
+// repetitions, and reports the mean cost of one operation with a 95% confidence interval
+
+typedef struct {
+    bool json;
+    size_t warmup;
+    size_t repetitions;
+    // operations per repetition (select fan-in divides them by the fan-in)
+    size_t ops;
+    // buffer of the throughput and create/destroy channels
+    size_t buffer;
+} bench_options_t;
+
+// One case of a benchmark: run times one repetition of ops operations and returns its duration
+typedef struct bench_case {
+    const char* name;
+    const char* variant;
+    size_t threads;
+    size_t buffer;
+    size_t ops;
+    // throughput: producers and consumers; select: fan-in; close: waiters
+    size_t producers;
+    size_t consumers;
+    uint64_t (*run)(const struct bench_case* c);
+} bench_case_t;
+
+static bench_options_t options;
+static size_t rows;
+
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void destroy_channel(channel_t* channel)
+{
+    enum channel_status status = channel_close(channel);
+    assert(status == SUCCESS);
+    status = channel_destroy(channel);
+    assert(status == SUCCESS);
+}
+
+// Two-sided 95% quantile of Student's t distribution with df degrees of freedom
+static double student_t95(size_t df)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df == 0) {
+        return 0;
+    }
+    return (df <= sizeof(table) / sizeof(table[0])) ? table[df - 1] : 1.96;
+}
+
+/* Ping-pong: a round trip through two channels and a second thread
+ */
+static void* pong_thread(void* arg)
+{
+    channel_t** pair = arg;
+    while (true) {
+        void* data;
+        enum channel_status status = channel_receive(pair[0], &data);
+        assert(status == SUCCESS);
+        if (data == NULL) {
+            break;
+        }
+        status = channel_send(pair[1], data);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+static uint64_t run_ping_pong(const bench_case_t* c)
+{
+    channel_t* pair[2] = {channel_create(c->buffer), channel_create(c->buffer)};
+    assert(pair[0] != NULL && pair[1] != NULL);
+    pthread_t pong;
+    int pthread_status = pthread_create(&pong, NULL, pong_thread, pair);
+    assert(pthread_status == 0);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < c->ops; i++) {
+        void* data;
+        enum channel_status status = channel_send(pair[0], (void*)1);
+        assert(status == SUCCESS);
+        status = channel_receive(pair[1], &data);
+        assert(status == SUCCESS);
+    }
+    uint64_t elapsed = now_ns() - start;
+    enum channel_status status = channel_send(pair[0], NULL);
+    assert(status == SUCCESS);
+    pthread_join(pong, NULL);
+    destroy_channel(pair[0]);
+    destroy_channel(pair[1]);
+    return elapsed;
+}
+
+/* Throughput: producers and consumers sharing one channel
+ */
+typedef struct {
+    channel_t* channel;
+    pthread_barrier_t* start;
+    size_t count;
+} throughput_arg_t;
+
+static void* producer_thread(void* arg)
+{
+    throughput_arg_t* producer = arg;
+    pthread_barrier_wait(producer->start);
+    for (size_t i = 1; i <= producer->count; i++) {
+        enum channel_status status = channel_send(producer->channel, (void*)i);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+static void* consumer_thread(void* arg)
+{
+    throughput_arg_t* consumer = arg;
+    pthread_barrier_wait(consumer->start);
+    while (true) {
+        void* data;
+        enum channel_status status = channel_receive(consumer->channel, &data);
+        assert(status == SUCCESS);
+        if (data == NULL) {
+            break;
+        }
+        consumer->count++;
+    }
+    return NULL;
+}
+
+static uint64_t run_throughput(const bench_case_t* c)
+{
+    size_t threads = c->producers + c->consumers;
+    channel_t* channel = channel_create(c->buffer);
+    assert(channel != NULL);
+    pthread_barrier_t start_barrier;
+    pthread_barrier_init(&start_barrier, NULL, (unsigned)(threads + 1));
+    throughput_arg_t* args = calloc(threads, sizeof(throughput_arg_t));
+    pthread_t* pid = malloc(sizeof(pthread_t) * threads);
+    assert(args != NULL && pid != NULL);
+    for (size_t i = 0; i < threads; i++) {
+        args[i].channel = channel;
+        args[i].start = &start_barrier;
+        // the producers split the messages, the consumers count what they received
+        if (i < c->producers) {
+            args[i].count = c->ops / c->producers + (i < c->ops % c->producers);
+        }
+        int pthread_status = pthread_create(&pid[i], NULL, (i < c->producers) ? producer_thread : consumer_thread, &args[i]);
+        assert(pthread_status == 0);
+    }
+    pthread_barrier_wait(&start_barrier);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < c->producers; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    for (size_t i = 0; i < c->consumers; i++) {
+        // stops one consumer once every message was taken
+        enum channel_status status = channel_send(channel, NULL);
+        assert(status == SUCCESS);
+    }
+    size_t received = 0;
+    for (size_t i = c->producers; i < threads; i++) {
+        pthread_join(pid[i], NULL);
+        received += args[i].count;
+    }
+    uint64_t elapsed = now_ns() - start;
+    assert(received == c->ops);
+    pthread_barrier_destroy(&start_barrier);
+    destroy_channel(channel);
+    free(args);
+    free(pid);
+    return elapsed;
+}
+
+/* Poll cost: non-blocking calls that find nothing to do, and a send/receive pair that succeeds
+ */
+static uint64_t run_poll(const bench_case_t* c)
+{
+    channel_t* channel = channel_create(1);
+    assert(channel != NULL);
+    enum channel_status status;
+    void* data;
+    uint64_t start;
+    if (strcmp(c->variant, "full_send") == 0) {
+        status = channel_send(channel, (void*)1);
+        assert(status == SUCCESS);
+        start = now_ns();
+        for (size_t i = 0; i < c->ops; i++) {
+            status = channel_non_blocking_send(channel, (void*)1);
+            assert(status == CHANNEL_FULL);
+        }
+    } else if (strcmp(c->variant, "empty_receive") == 0) {
+        start = now_ns();
+        for (size_t i = 0; i < c->ops; i++) {
+            status = channel_non_blocking_receive(channel, &data);
+            assert(status == CHANNEL_EMPTY);
+        }
+    } else {
+        start = now_ns();
+        for (size_t i = 0; i < c->ops; i++) {
+            status = channel_non_blocking_send(channel, (void*)1);
+            assert(status == SUCCESS);
+            status = channel_non_blocking_receive(channel, &data);
+            assert(status == SUCCESS);
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    destroy_channel(channel);
+    return elapsed;
+}
+
+/* Select fan-in: one thread selecting over many channels fed round-robin by a producer
+ */
+typedef struct {
+    channel_t** channels;
+    size_t count;
+    size_t ops;
+} fan_in_arg_t;
+
+static void* fan_in_producer(void* arg)
+{
+    fan_in_arg_t* fan_in = arg;
+    for (size_t i = 0; i < fan_in->ops; i++) {
+        enum channel_status status = channel_send(fan_in->channels[i % fan_in->count], (void*)1);
+        assert(status == SUCCESS);
+    }
+    return NULL;
+}
+
+static uint64_t run_select(const bench_case_t* c)
+{
+    size_t count = c->producers;
+    channel_t** channels = malloc(sizeof(channel_t*) * count);
+    select_t* list = calloc(count, sizeof(select_t));
+    assert(channels != NULL && list != NULL);
+    for (size_t i = 0; i < count; i++) {
+        channels[i] = channel_create(1);
+        assert(channels[i] != NULL);
+        list[i].channel = channels[i];
+        list[i].dir = RECV;
+    }
+    fan_in_arg_t arg = {channels, count, c->ops};
+    pthread_t producer;
+    uint64_t start = now_ns();
+    int pthread_status = pthread_create(&producer, NULL, fan_in_producer, &arg);
+    assert(pthread_status == 0);
+    for (size_t i = 0; i < c->ops; i++) {
+        size_t index;
+        enum channel_status status = channel_select(list, count, &index);
+        assert(status == SUCCESS && index < count);
+    }
+    uint64_t elapsed = now_ns() - start;
+    pthread_join(producer, NULL);
+    for (size_t i = 0; i < count; i++) {
+        destroy_channel(channels[i]);
+    }
+    free(channels);
+    free(list);
+    return elapsed;
+}
+
+/* Close/wake-all: from closing a channel until the last of its blocked receivers returned
+ */
+typedef struct {
+    channel_t* channel;
+    atomic_size_t* blocked;
+    uint64_t woke;
+} waiter_arg_t;
+
+static void* waiter_thread(void* arg)
+{
+    waiter_arg_t* waiter = arg;
+    void* data;
+    atomic_fetch_add(waiter->blocked, 1);
+    enum channel_status status = channel_receive(waiter->channel, &data);
+    waiter->woke = now_ns();
+    assert(status == CLOSED_ERROR);
+    return NULL;
+}
+
+static uint64_t run_close(const bench_case_t* c)
+{
+    size_t waiters = c->consumers;
+    channel_t* channel = channel_create(1);
+    assert(channel != NULL);
+    atomic_size_t blocked = 0;
+    waiter_arg_t* args = calloc(waiters, sizeof(waiter_arg_t));
+    pthread_t* pid = malloc(sizeof(pthread_t) * waiters);
+    assert(args != NULL && pid != NULL);
+    for (size_t i = 0; i < waiters; i++) {
+        args[i].channel = channel;
+        args[i].blocked = &blocked;
+        int pthread_status = pthread_create(&pid[i], NULL, waiter_thread, &args[i]);
+        assert(pthread_status == 0);
+    }
+    while (atomic_load(&blocked) < waiters) {
+        sched_yield();
+    }
+    // give the last waiters time to block in channel_receive
+    usleep(2000);
+    uint64_t start = now_ns();
+    enum channel_status status = channel_close(channel);
+    assert(status == SUCCESS);
+    uint64_t last = start;
+    for (size_t i = 0; i < waiters; i++) {
+        pthread_join(pid[i], NULL);
+        last = (args[i].woke > last) ? args[i].woke : last;
+    }
+    status = channel_destroy(channel);
+    assert(status == SUCCESS);
+    free(args);
+    free(pid);
+    return last - start;
+}
+
+/* Create/destroy: the full life cycle of a channel
+ */
+static uint64_t run_create(const bench_case_t* c)
+{
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < c->ops; i++) {
+        channel_t* channel = channel_create(c->buffer);
+        assert(channel != NULL);
+        destroy_channel(channel);
+    }
+    return now_ns() - start;
+}
+
+// Runs the warm-up and measured repetitions of a case and prints its row
+static void measure(const bench_case_t* c)
+{
+    for (size_t r = 0; r < options.warmup; r++) {
+        c->run(c);
+    }
+    double* samples = malloc(sizeof(double) * options.repetitions);
+    assert(samples != NULL);
+    double sum = 0;
+    double min = INFINITY;
+    double max = 0;
+    for (size_t r = 0; r < options.repetitions; r++) {
+        samples[r] = (double)c->run(c) / (double)c->ops;
+        sum += samples[r];
+        min = (samples[r] < min) ? samples[r] : min;
+        max = (samples[r] > max) ? samples[r] : max;
+    }
+    size_t n = options.repetitions;
+    double mean = sum / (double)n;
+    double squares = 0;
+    for (size_t r = 0; r < n; r++) {
+        squares += (samples[r] - mean) * (samples[r] - mean);
+    }
+    double stddev = (n > 1) ? sqrt(squares / (double)(n - 1)) : 0;
+    double ci95 = student_t95(n - 1) * stddev / sqrt((double)n);
+    double ops_per_sec = (mean > 0) ? 1e9 / mean : 0;
+    free(samples);
+
+    if (options.json) {
+        printf("%s  {\"benchmark\": \"%s\", \"variant\": \"%s\", \"threads\": %zu, \"buffer\": %zu, \"ops\": %zu, "
+               "\"repetitions\": %zu, \"mean_ns\": %.2f, \"stddev_ns\": %.2f, \"ci95_ns\": %.2f, \"min_ns\": %.2f, "
+               "\"max_ns\": %.2f, \"ops_per_sec\": %.0f}",
+               (rows == 0) ? "" : ",\n", c->name, c->variant, c->threads, c->buffer, c->ops, n, mean, stddev, ci95,
+               min, max, ops_per_sec);
+    } else {
+        printf("%s,%s,%zu,%zu,%zu,%zu,%.2f,%.2f,%.2f,%.2f,%.2f,%.0f\n", c->name, c->variant, c->threads, c->buffer,
+               c->ops, n, mean, stddev, ci95, min, max, ops_per_sec);
+    }
+    fflush(stdout);
+    rows++;
+}
+
+static int usage(const char* program)
+{
+    printf("Usage: %s [-f csv|json] [-w warmup] [-r repetitions] [-n ops] [-b buffer] [benchmarks...]\n", program);
+    printf("  Runs the channel microbenchmarks and prints the mean cost of one operation per case with the\n");
+    printf("  95%% confidence interval over the repetitions; defaults are -f csv -w 2 -r 10 -n 100000 -b 16\n");
+    printf("  benchmarks: ping_pong (ns per round trip), throughput (spsc, mpsc, spmc, mpmc), poll\n");
+    printf("  (non-blocking calls), select (fan-in 1 to 1024), close (wake-all latency), create (create/destroy)\n");
+    printf("  all of them run if none is given\n");
+    return 1;
+}
+
+// Parses a count, which must be positive unless zero is allowed
+static bool parse_count(const char* text, size_t* value, bool zero)
+{
+    char* end;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    *value = (size_t)parsed;
+    return end != text && *end == '\0' && (parsed > 0 || zero);
+}
+
+static bool selected(char** names, int count, const char* name)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return true;
+        }
+    }
+    return count == 0;
+}
+
+int main(int argc, char** argv)
+{
+    options.json = false;
+    options.warmup = 2;
+    options.repetitions = 10;
+    options.ops = 100000;
+    options.buffer = 16;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i += 2) {
+        bool valid = i + 1 < argc;
+        if (valid && strcmp(argv[i], "-f") == 0) {
+            valid = strcmp(argv[i + 1], "csv") == 0 || strcmp(argv[i + 1], "json") == 0;
+            options.json = strcmp(argv[i + 1], "json") == 0;
+        } else if (valid && strcmp(argv[i], "-w") == 0) {
+            valid = parse_count(argv[i + 1], &options.warmup, true);
+        } else if (valid && strcmp(argv[i], "-r") == 0) {
+            valid = parse_count(argv[i + 1], &options.repetitions, false);
+        } else if (valid && strcmp(argv[i], "-n") == 0) {
+            valid = parse_count(argv[i + 1], &options.ops, false);
+        } else if (valid && strcmp(argv[i], "-b") == 0) {
+            valid = parse_count(argv[i + 1], &options.buffer, false);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            return usage(argv[0]);
+        }
+    }
+    static const char* known[] = {"ping_pong", "throughput", "poll", "select", "close", "create"};
+    char** names = &argv[i];
+    int name_count = argc - i;
+    for (int n = 0; n < name_count; n++) {
+        bool found = false;
+        for (size_t k = 0; k < sizeof(known) / sizeof(known[0]); k++) {
+            found = found || strcmp(names[n], known[k]) == 0;
+        }
+        if (!found) {
+            return usage(argv[0]);
+        }
+    }
+
+    size_t ops = options.ops;
+    if (options.json) {
+        printf("[\n");
+    } else {
+        printf("benchmark,variant,threads,buffer,ops,repetitions,mean_ns,stddev_ns,ci95_ns,min_ns,max_ns,ops_per_sec\n");
+    }
+    if (selected(names, name_count, "ping_pong")) {
+        measure(&(bench_case_t){"ping_pong", "round_trip", 2, 1, ops, 0, 0, run_ping_pong});
+    }
+    if (selected(names, name_count, "throughput")) {
+        static const struct {
+            const char* variant;
+            size_t producers;
+            size_t consumers;
+        } shapes[] = {{"spsc", 1, 1}, {"mpsc", 4, 1}, {"spmc", 1, 4}, {"mpmc", 4, 4}};
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+            measure(&(bench_case_t){"throughput", shapes[s].variant, shapes[s].producers + shapes[s].consumers,
+                                    options.buffer, ops, shapes[s].producers, shapes[s].consumers, run_throughput});
+        }
+    }
+    if (selected(names, name_count, "poll")) {
+        static const char* variants[] = {"empty_receive", "full_send", "send_receive"};
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+            measure(&(bench_case_t){"poll", variants[v], 1, 1, ops, 0, 0, run_poll});
+        }
+    }
+    if (selected(names, name_count, "select")) {
+        for (size_t fan_in = 1; fan_in <= 1024; fan_in *= 4) {
+            char variant[32];
+            snprintf(variant, sizeof(variant), "fan_in_%zu", fan_in);
+            // every select scans all channels, so wider selects run fewer operations (but still
+            // receive from every channel a few times)
+            size_t select_ops = (ops / fan_in > 4 * fan_in) ? ops / fan_in : 4 * fan_in;
+            measure(&(bench_case_t){"select", variant, 2, 1, select_ops, fan_in, 0, run_select});
+        }
+    }
+    if (selected(names, name_count, "close")) {
+        for (size_t waiters = 1; waiters <= 64; waiters *= 4) {
+            char variant[32];
+            snprintf(variant, sizeof(variant), "waiters_%zu", waiters);
+            measure(&(bench_case_t){"close", variant, waiters + 1, 1, 1, 0, waiters, run_close});
+        }
+    }
+    if (selected(names, name_count, "create")) {
+        measure(&(bench_case_t){"create", "create_destroy", 1, options.buffer, ops, 0, 0, run_create});
+    }
+    if (options.json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
@@ -1,5 +1,12 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include "buffer.h"
 
+#define BUFFER_MAX_NUMA_NODES 1024
+
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity)
 {
@@ -9,6 +16,74 @@ buffer_t* buffer_create(size_t capacity)
     buffer->next = 0;
     buffer->capacity = capacity;
     buffer->data = data;
+    buffer->mapped = 0;
+    return buffer;
+}
+
+// Returns the NUMA node of the CPU the calling thread is running on
+static int buffer_current_node()
+{
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        return BUFFER_NUMA_ANY;
+    }
+    return (int)node;
+}
+
+// Maps len bytes of anonymous memory backed by the requested pages
+// Returns NULL if the mapping could not be created
+static void* buffer_map(size_t len, enum buffer_pages pages)
+{
+    void* addr = MAP_FAILED;
+    if (pages == BUFFER_PAGES_EXPLICIT) {
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED && pages != BUFFER_PAGES_DEFAULT) {
+            madvise(addr, len, MADV_HUGEPAGE);
+        }
+    }
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+// Creates a buffer with the given capacity whose data is placed on numa_node
+// (or BUFFER_NUMA_ANY/BUFFER_NUMA_CURRENT) and backed by the given pages
+buffer_t* buffer_create_placed(size_t capacity, int numa_node, enum buffer_pages pages)
+{
+    size_t bytes = capacity * sizeof(void*);
+    if (bytes < BUFFER_HUGE_PAGE_SIZE) {
+        pages = BUFFER_PAGES_DEFAULT;
+    }
+    if (numa_node == BUFFER_NUMA_CURRENT) {
+        numa_node = buffer_current_node();
+    }
+    if (bytes == 0 || (numa_node < 0 && pages == BUFFER_PAGES_DEFAULT)) {
+        return buffer_create(capacity);
+    }
+
+    size_t align = (pages == BUFFER_PAGES_DEFAULT) ? (size_t)sysconf(_SC_PAGESIZE) : BUFFER_HUGE_PAGE_SIZE;
+    size_t len = (bytes + align - 1) & ~(align - 1);
+    void** data = buffer_map(len, pages);
+    if (data == NULL) {
+        return buffer_create(capacity);
+    }
+    if (numa_node >= 0 && numa_node < BUFFER_MAX_NUMA_NODES) {
+        // prefer the node but let the kernel fall back when it runs out of memory
+        unsigned long mask[BUFFER_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = {0};
+        mask[(size_t)numa_node / (8 * sizeof(unsigned long))] |= 1ul << ((size_t)numa_node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, data, len, MPOL_PREFERRED, mask, BUFFER_MAX_NUMA_NODES, 0);
+    }
+    // fault every page in now so it lands on the chosen node instead of wherever the first sender runs
+    memset(data, 0, len);
+
+    buffer_t* buffer = (buffer_t*) malloc(sizeof(buffer_t));
+    buffer->size = 0;
+    buffer->next = 0;
+    buffer->capacity = capacity;
+    buffer->data = data;
+    buffer->mapped = len;
     return buffer;
 }
 
@@ -49,7 +124,11 @@ enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t *buffer)
 {
-    free(buffer->data);
+    if (buffer->mapped != 0) {
+        munmap(buffer->data, buffer->mapped);
+    } else {
+        free(buffer->data);
+    }
     free(buffer);
 }
 
@@ -8,8 +8,23 @@ typedef struct {
     size_t next;
     size_t capacity;
     void** data;
+    size_t mapped; // bytes of data obtained with mmap (0 if data was malloc'd)
 } buffer_t;
 
+// Special NUMA node values for buffer_create_placed
+#define BUFFER_NUMA_ANY -1     // no placement policy, first touch decides
+#define BUFFER_NUMA_CURRENT -2 // node of the CPU the creating thread runs on
+
+// Huge page size used to align huge-page backed buffers
+#define BUFFER_HUGE_PAGE_SIZE (2ul * 1024 * 1024)
+
+// Page backing for a buffer's data
+enum buffer_pages {
+    BUFFER_PAGES_DEFAULT = 0,     // normal pages
+    BUFFER_PAGES_TRANSPARENT = 1, // huge-page aligned and advised for transparent huge pages
+    BUFFER_PAGES_EXPLICIT = 2     // MAP_HUGETLB pages, falls back to transparent if none are reserved
+};
+
 enum buffer_status {
     BUFFER_SUCCESS = 1,
     BUFFER_ERROR = -1
@@ -18,6 +33,12 @@ enum buffer_status {
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity);
 
+// Creates a buffer with the given capacity whose data is placed on numa_node
+// (or BUFFER_NUMA_ANY/BUFFER_NUMA_CURRENT) and backed by the given pages
+// Huge pages are only used when the data is at least BUFFER_HUGE_PAGE_SIZE bytes
+// Placement is best effort: on machines without NUMA or huge pages the buffer is still created
+buffer_t* buffer_create_placed(size_t capacity, int numa_node, enum buffer_pages pages);
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
@@ -10,12 +10,36 @@
 channel_t* channel_create(size_t size)
 {
     /* IMPLEMENT THIS */
-   
+    
+    //Create the channel with the default attributes
+    return channel_create_attr(size, NULL);
+}
+
+// Initializes attr with the defaults used by channel_create (no NUMA policy, normal pages)
+void channel_attr_init(channel_attr_t* attr)
+{
+    //No NUMA policy, the first thread to touch the ring decides
+    attr -> numa_node = BUFFER_NUMA_ANY;
+    //Normal pages
+    attr -> pages = BUFFER_PAGES_DEFAULT;
+}
+
+// Creates a new channel with the provided size whose ring memory follows attr and returns it to the caller
+// A NULL attr behaves exactly like channel_create
+channel_t* channel_create_attr(size_t size, const channel_attr_t* attr)
+{
     //Malloc used to allocate memory for the channel
     channel_t *chann = malloc(sizeof(channel_t));
    
-    //Creates a buffer size
-    chann -> buffer = buffer_create(size);
+    //Use the defaults if no attributes were given
+    channel_attr_t defaults;
+    if (attr == NULL) {
+        channel_attr_init(&defaults);
+        attr = &defaults;
+    }
+   
+    //Creates a buffer size on the requested node and pages
+    chann -> buffer = buffer_create_placed(size, attr -> numa_node, attr -> pages);
    
     //If the size is not zero, the channel starts as empty
     if(size != 0){
@@ -66,11 +90,55 @@ channel_t* channel_create(size_t size)
         return NULL;
     }    
    
+    //Initilize the condBatch
+    int condBatchInitial = pthread_cond_init(&chann -> condBatch, NULL);
+    //If initialization fails destroy mutex, all other conditions, and free memory
+    if (condBatchInitial != 0) {
+        pthread_mutex_destroy(&chann -> mutex);
+        pthread_cond_destroy(&chann -> waitGen);
+        pthread_cond_destroy(&chann -> condGen);
+        pthread_cond_destroy(&chann -> condCon);
+        free(chann);
+        return NULL;
+    }
+   
+#ifdef CHANNEL_STATS
+    //Allocate the statistics shards, each on its own cache line
+    chann -> stats = aligned_alloc(sizeof(channel_stats_shard_t), sizeof(channel_stats_shard_t) * CHANNEL_STATS_SHARDS);
+    //If allocation fails destroy mutex, all conditions, and free memory
+    if (chann -> stats == NULL) {
+        pthread_mutex_destroy(&chann -> mutex);
+        pthread_cond_destroy(&chann -> condBatch);
+        pthread_cond_destroy(&chann -> waitGen);
+        pthread_cond_destroy(&chann -> condGen);
+        pthread_cond_destroy(&chann -> condCon);
+        free(chann);
+        return NULL;
+    }
+    //All counters start at zero
+    memset(chann -> stats, 0, sizeof(channel_stats_shard_t) * CHANNEL_STATS_SHARDS);
+#else
+    //No statistics are kept
+    chann -> stats = NULL;
+#endif
+    chann -> peakOcc = 0;
+   
     //Initialize the buffer size
     chann -> buffSize = size;
     //Initialize the wait count
     chann -> waitCon = 0;
    
+    //Initialize the watermarks so every item wakes a waiter
+    chann -> lowWater = (size != 0) ? size - 1 : 0;
+    chann -> highWater = 1;
+    //Initialize the batch and send waiting counts
+    chann -> batchNeed = SIZE_MAX;
+    chann -> batchWait = 0;
+    chann -> sendWait = 0;
+    //Initialize with no readiness callback
+    chann -> readyCallback = NULL;
+    chann -> readyArg = NULL;
+   
     //Initialize the lists for receieve and send
     chann -> recSel = list_create();
     chann -> sendSel = list_create();
@@ -96,6 +164,111 @@ void signal_threads(list_t* list)
     }
 }
 
+//Helper function
+//Wakes blocked senders once the buffer has drained to the low watermark
+void wake_senders(channel_t *channel)
+{
+    //Current number of items in the buffer
+    size_t occupancy = buffer_current_size(channel -> buffer);
+    
+    //Just crossed a raised low watermark, every slot above it is free so wake all senders
+    if (occupancy == channel -> lowWater && channel -> lowWater + 1 < channel -> buffSize) {
+        pthread_cond_broadcast(&channel -> condGen);
+    }
+    //At or below the low watermark, one slot was freed so wake one sender
+    else if (occupancy <= channel -> lowWater) {
+        pthread_cond_signal(&channel -> condGen);
+    }
+}
+
+//Helper function
+//Tells the readiness callback, if any, that the channel may be ready for dir
+void notify_ready(channel_t *channel, enum direction dir)
+{
+    //Only call the callback if one was registered
+    if (channel -> readyCallback != NULL) {
+        channel -> readyCallback(channel, dir, channel -> readyArg);
+    }
+}
+
+//Helper function
+//Returns the statistics shard of the calling thread
+#ifdef CHANNEL_STATS
+channel_stats_shard_t* stats_shard(channel_t *channel)
+{
+    //Fibonacci hash of the thread id spreads the threads over the shards
+    uint64_t hash = (uint64_t)pthread_self() * 0x9E3779B97F4A7C15ull;
+    return &channel -> stats[(hash >> 32) & (CHANNEL_STATS_SHARDS - 1)];
+}
+#endif
+
+//Helper function
+//Returns the monotonic clock in nanoseconds, or 0 when statistics are compiled out
+uint64_t stats_now(void)
+{
+#ifdef CHANNEL_STATS
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+//Helper function
+//Counts count messages sent or received in direction dir
+void stats_op(channel_t *channel, enum direction dir, uint64_t count)
+{
+#ifdef CHANNEL_STATS
+    channel_stats_shard_t* shard = stats_shard(channel);
+    //Relaxed is enough, the counters don't order anything
+    __atomic_fetch_add((dir == SEND) ? &shard -> sends : &shard -> receives, count, __ATOMIC_RELAXED);
+#endif
+}
+
+//Helper function
+//Counts a non-blocking call in direction dir that found the channel full or empty
+void stats_fail(channel_t *channel, enum direction dir)
+{
+#ifdef CHANNEL_STATS
+    channel_stats_shard_t* shard = stats_shard(channel);
+    __atomic_fetch_add((dir == SEND) ? &shard -> send_full : &shard -> receive_empty, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+//Helper function
+//Counts an operation that started blocking at waitStart (0 if it never blocked) and was woken wakes times
+//Every wakeup but the last one found the channel still not ready
+void stats_waited(channel_t *channel, uint64_t waitStart, uint64_t wakes)
+{
+#ifdef CHANNEL_STATS
+    //Nothing to count if the operation never blocked
+    if (waitStart == 0) {
+        return;
+    }
+    channel_stats_shard_t* shard = stats_shard(channel);
+    __atomic_fetch_add(&shard -> blocking_waits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard -> wait_ns, stats_now() - waitStart, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard -> wakeups, wakes, __ATOMIC_RELAXED);
+    if (wakes > 1) {
+        __atomic_fetch_add(&shard -> spurious_wakeups, wakes - 1, __ATOMIC_RELAXED);
+    }
+#endif
+}
+
+//Helper function
+//Updates the peak occupancy after a message was added, the channel must be locked
+//Unlike the shards this shares the channel's line, but every send already holds the mutex there
+void stats_peak(channel_t *channel)
+{
+#ifdef CHANNEL_STATS
+    size_t occupancy = buffer_current_size(channel -> buffer);
+    if (occupancy > channel -> peakOcc) {
+        channel -> peakOcc = occupancy;
+    }
+#endif
+}
+
 //Helper function
 //Updating thread status' during data transfer based on its direction
 void channelDirection(channel_t *channel, void* data, enum direction dir)
@@ -107,6 +280,9 @@ void channelDirection(channel_t *channel, void* data, enum direction dir)
         if (dir == SEND) {
             //Add the data 
             buffer_add(channel -> buffer, data);
+            //Count the send and the new occupancy
+            stats_op(channel, SEND, 1);
+            stats_peak(channel);
             
             //If the buffer has no more space change the status to be full
             if (buffer_current_size(channel -> buffer) == channel -> buffSize) {
@@ -121,12 +297,24 @@ void channelDirection(channel_t *channel, void* data, enum direction dir)
             signal_threads(channel -> recSel);
             //Signal that the data is accessible
             pthread_cond_signal(&channel -> condCon);
+            
+            //Wake the batch receivers once the smallest batch any of them wants is available
+            if (channel -> batchWait > 0 && buffer_current_size(channel -> buffer) >= channel -> batchNeed) {
+                //Waiters that still need more re-register their batch size
+                channel -> batchNeed = SIZE_MAX;
+                pthread_cond_broadcast(&channel -> condBatch);
+            }
+            
+            //Tell the callback there is something to receive
+            notify_ready(channel, RECV);
 
         } 
         //If the direction is to receive
         else if (dir == RECV) {
             //Removed the data
             buffer_remove(channel->buffer, data);
+            //Count the receive
+            stats_op(channel, RECV, 1);
 
             //If buffer is now empty change its status to be empty
             if (buffer_current_size(channel->buffer) == 0) {
@@ -146,8 +334,11 @@ void channelDirection(channel_t *channel, void* data, enum direction dir)
             }
             //If the buffer size is not zero signal not to wait
             else if (channel -> buffSize != 0) {
-                pthread_cond_signal(&channel->condGen); 
+                wake_senders(channel);
             }
+            
+            //Tell the callback there is room to send
+            notify_ready(channel, SEND);
         }
     }
 }
@@ -163,10 +354,21 @@ enum channel_status channel_send(channel_t *channel, void* data)
     //Lock mutex
     pthread_mutex_lock(&channel -> mutex);
 
+    //When this sender started blocking and how often it was woken, for the statistics
+    uint64_t waitStart = 0, wakes = 0;
+
     //If the channel is full wait for space to become available in the buffer
     while (channel -> stat == CHANNEL_FULL || (channel -> buffSize == 0 && buffer_current_size(channel -> buffer) == 1)) {
+        if (waitStart == 0) {
+            waitStart = stats_now();
+        }
+        //Count this sender as waiting so batch receivers can wake it
+        channel -> sendWait = channel -> sendWait + 1;
         pthread_cond_wait(&channel -> condGen, &channel -> mutex);
+        channel -> sendWait = channel -> sendWait - 1;
+        wakes = wakes + 1;
     }
+    stats_waited(channel, waitStart, wakes);
 
     //If the channel is closed return a closed error
     if (channel -> stat == CHANNEL_CLOSED) {
@@ -194,11 +396,18 @@ enum channel_status channel_receive(channel_t* channel, void** data)
     //Lock mutex
     pthread_mutex_lock(&channel -> mutex);
 
+    //When this receiver started blocking and how often it was woken, for the statistics
+    uint64_t waitStart = 0, wakes = 0;
+
     //If the channel is not empty or full or has data available
     while (channel-> stat == CHANNEL_EMPTY || (channel -> buffSize == 0 && channel -> stat == CHANNEL_FULL)) {
         //If the buffer has data in it wait for the signaled condition
         if (channel -> buffSize != 0) {
+            if (waitStart == 0) {
+                waitStart = stats_now();
+            }
             pthread_cond_wait(&channel -> condCon, &channel -> mutex);
+            wakes = wakes + 1;
         }
         //Otherwise increment waitcon and signal for other threads to send data
         else {
@@ -206,6 +415,7 @@ enum channel_status channel_receive(channel_t* channel, void** data)
             signal_threads(channel -> sendSel);
         }
     }
+    stats_waited(channel, waitStart, wakes);
 
     //If the channel is closed return a closed error
     if (channel -> stat == CHANNEL_CLOSED) {
@@ -277,8 +487,9 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
    
     //If the channel status is full
     if (channel -> stat == CHANNEL_FULL) {
-        //Unlock mutex and return channel is full
+        //Unlock mutex, count the failure and return channel is full
         pthread_mutex_unlock(&channel -> mutex);
+        stats_fail(channel, SEND);
         return CHANNEL_FULL;
     }
    
@@ -287,6 +498,11 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data)
    
     //Unlock mutex after the call to helper function is complete
     pthread_mutex_unlock(&channel -> mutex);
+    
+    //Count the failure if there was no room after all
+    if (sendStat == CHANNEL_FULL) {
+        stats_fail(channel, SEND);
+    }
    
     //Return the result of the send
     return sendStat;
@@ -362,8 +578,9 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
     
     //If the channel status is empty
     if (channel -> stat == CHANNEL_EMPTY) {
-        //Unlock mutex and return channel is empty
+        //Unlock mutex, count the failure and return channel is empty
         pthread_mutex_unlock(&channel -> mutex);
+        stats_fail(channel, RECV);
         return CHANNEL_EMPTY;
     }
      
@@ -372,6 +589,11 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
     
     //Unlock mutex after the call to helper function is complete
     pthread_mutex_unlock(&channel -> mutex);
+    
+    //Count the failure if there was nothing to receive after all
+    if (recStat == CHANNEL_EMPTY) {
+        stats_fail(channel, RECV);
+    }
 
     //Return the result of the receive
     return recStat;
@@ -400,10 +622,15 @@ enum channel_status channel_close(channel_t* channel)
         //Broadcasat to all the threads that channel is closed
         pthread_cond_broadcast(&channel -> condGen);
         pthread_cond_broadcast(&channel -> condCon);
+        pthread_cond_broadcast(&channel -> condBatch);
    
         //Signal all threads that the send and recieve operations will cease to function using helper function
         signal_threads(channel -> sendSel);
         signal_threads(channel -> recSel);
+        
+        //Tell the callback both directions will now fail with the closed error
+        notify_ready(channel, SEND);
+        notify_ready(channel, RECV);
    
         //Unlock mutex
         pthread_mutex_unlock(&channel -> mutex);
@@ -434,6 +661,9 @@ enum channel_status channel_destroy(channel_t* channel)
         //Free the buffer on the channel
         buffer_free(channel -> buffer);    
    
+        //Free the statistics shards, if any
+        free(channel -> stats);
+   
         //Destroy the receive list
         list_destroy(channel -> recSel);
    
@@ -461,6 +691,13 @@ enum channel_status channel_destroy(channel_t* channel)
             return DESTROY_ERROR;
         }
        
+        //Destroy the condBatch
+        int condBatchDestroy = pthread_cond_destroy(&channel -> condBatch);
+        //If the destroy fails return a destroy error
+        if (condBatchDestroy != 0) {
+            return DESTROY_ERROR;
+        }
+       
         //Destroy the mutex
         int mutexDestroy = pthread_mutex_destroy(&channel -> mutex);
         //If destroy fails return a destroy error
@@ -480,6 +717,173 @@ enum channel_status channel_destroy(channel_t* channel)
     }
 } 
 
+// Sets the flow control watermarks of a buffered channel
+// Senders blocked on a full channel are only woken once it drains to low items, and
+// channel_receive_batch calls with min_batch 0 wait until high items are buffered
+// Returns SUCCESS, or GENERIC_ERROR if the channel is unbuffered, low >= size, or high is 0 or larger than size
+enum channel_status channel_set_watermarks(channel_t* channel, size_t low, size_t high)
+{
+    //If the channel is NULL or unbuffered or the watermarks don't fit the buffer, return a generic error
+    if (channel == NULL || channel -> buffSize == 0 || low >= channel -> buffSize || high == 0 || high > channel -> buffSize) {
+        return GENERIC_ERROR;
+    }
+    
+    //Lock mutex
+    pthread_mutex_lock(&channel -> mutex);
+    
+    //Store the new watermarks
+    channel -> lowWater = low;
+    channel -> highWater = high;
+    
+    //Senders may already be allowed to run under the new low watermark
+    pthread_cond_broadcast(&channel -> condGen);
+    
+    //Unlock mutex
+    pthread_mutex_unlock(&channel -> mutex);
+    return SUCCESS;
+}
+
+// Reads up to max messages from the given channel into data and stores how many were read in count
+// This is a blocking call that waits until at least min_batch messages (or max, or the channel size,
+// whichever is smaller) are buffered
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the channel is unbuffered or the arguments are invalid
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t max, size_t min_batch, size_t* count)
+{
+    //If any argument is invalid or the channel is unbuffered, return a generic error
+    if (channel == NULL || data == NULL || count == NULL || max == 0 || channel -> buffSize == 0) {
+        return GENERIC_ERROR;
+    }
+    
+    //Lock mutex
+    pthread_mutex_lock(&channel -> mutex);
+    
+    //Use the high watermark if no batch size was given, and never wait for more than can be taken or buffered
+    size_t need = (min_batch == 0) ? channel -> highWater : min_batch;
+    if (need > max) {
+        need = max;
+    }
+    if (need > channel -> buffSize) {
+        need = channel -> buffSize;
+    }
+    
+    //When this receiver started blocking and how often it was woken, for the statistics
+    uint64_t waitStart = 0, wakes = 0;
+    
+    //Wait until the batch is available or the channel is closed
+    while (channel -> stat != CHANNEL_CLOSED && buffer_current_size(channel -> buffer) < need) {
+        if (waitStart == 0) {
+            waitStart = stats_now();
+        }
+        //Senders held back by the low watermark must run or the batch could never fill up
+        if (channel -> sendWait > 0) {
+            pthread_cond_broadcast(&channel -> condGen);
+        }
+        //Register the batch size so senders only wake this receiver once it is reached
+        if (need < channel -> batchNeed) {
+            channel -> batchNeed = need;
+        }
+        channel -> batchWait = channel -> batchWait + 1;
+        pthread_cond_wait(&channel -> condBatch, &channel -> mutex);
+        channel -> batchWait = channel -> batchWait - 1;
+        wakes = wakes + 1;
+    }
+    stats_waited(channel, waitStart, wakes);
+    
+    //If the channel is closed return a closed error
+    if (channel -> stat == CHANNEL_CLOSED) {
+        pthread_mutex_unlock(&channel -> mutex);
+        return CLOSED_ERROR;
+    }
+    
+    //Take as many messages as are buffered, up to max
+    size_t taken = 0;
+    while (taken < max && buffer_remove(channel -> buffer, &data[taken]) == BUFFER_SUCCESS) {
+        taken = taken + 1;
+    }
+    *count = taken;
+    //Count the whole batch at once
+    stats_op(channel, RECV, taken);
+    
+    //If buffer is now empty change its status to be empty, otherwise it has space now
+    if (buffer_current_size(channel -> buffer) == 0) {
+        channel -> stat = CHANNEL_EMPTY;
+    }
+    else {
+        channel -> stat = CHANNEL_OPEN;
+    }
+    
+    //Signal that the data was removed, once for the whole batch
+    signal_threads(channel -> sendSel);
+    if (buffer_current_size(channel -> buffer) <= channel -> lowWater) {
+        pthread_cond_broadcast(&channel -> condGen);
+    }
+    //Tell the callback there is room to send
+    notify_ready(channel, SEND);
+    
+    //Unlock mutex
+    pthread_mutex_unlock(&channel -> mutex);
+    //Return that the receive was successful
+    return SUCCESS;
+}
+
+// Registers callback to run (with arg) whenever a message is added to the channel (dir RECV),
+// a message is removed from it (dir SEND), or it is closed (both directions)
+// Returns SUCCESS, or GENERIC_ERROR if the channel is NULL
+enum channel_status channel_set_ready_callback(channel_t* channel, channel_ready_fn callback, void* arg)
+{
+    //If the channel is NULL, return a generic error
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    
+    //Lock mutex so the callback never changes halfway through a notification
+    pthread_mutex_lock(&channel -> mutex);
+    
+    //Store the callback and its argument
+    channel -> readyCallback = callback;
+    channel -> readyArg = arg;
+    
+    //Unlock mutex
+    pthread_mutex_unlock(&channel -> mutex);
+    return SUCCESS;
+}
+
+// Stores the channel's statistics so far in stats
+// Returns SUCCESS, or GENERIC_ERROR if an argument is NULL or the statistics were compiled out
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats)
+{
+    //If the channel or stats is NULL, return a generic error
+    if (channel == NULL || stats == NULL) {
+        return GENERIC_ERROR;
+    }
+#ifdef CHANNEL_STATS
+    //Add up every shard
+    memset(stats, 0, sizeof(channel_stats_t));
+    for (size_t i = 0; i < CHANNEL_STATS_SHARDS; i++) {
+        channel_stats_shard_t* shard = &channel -> stats[i];
+        stats -> sends += __atomic_load_n(&shard -> sends, __ATOMIC_RELAXED);
+        stats -> receives += __atomic_load_n(&shard -> receives, __ATOMIC_RELAXED);
+        stats -> send_full += __atomic_load_n(&shard -> send_full, __ATOMIC_RELAXED);
+        stats -> receive_empty += __atomic_load_n(&shard -> receive_empty, __ATOMIC_RELAXED);
+        stats -> blocking_waits += __atomic_load_n(&shard -> blocking_waits, __ATOMIC_RELAXED);
+        stats -> wait_ns += __atomic_load_n(&shard -> wait_ns, __ATOMIC_RELAXED);
+        stats -> wakeups += __atomic_load_n(&shard -> wakeups, __ATOMIC_RELAXED);
+        stats -> spurious_wakeups += __atomic_load_n(&shard -> spurious_wakeups, __ATOMIC_RELAXED);
+    }
+    
+    //The peak only changes with the channel locked
+    pthread_mutex_lock(&channel -> mutex);
+    stats -> peak_occupancy = channel -> peakOcc;
+    pthread_mutex_unlock(&channel -> mutex);
+    return SUCCESS;
+#else
+    //The statistics were compiled out
+    return GENERIC_ERROR;
+#endif
+}
+
 //Helper Function
 //Function loops through the list of channels ensuring that channels that refer to each
 //other are all unlocked if one is unlocked
@@ -607,6 +1011,8 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
 
     //Create index variable
     size_t indexChan = 0; 
+    //When this select started blocking and how often it was woken, counted on the channel it ends up using
+    uint64_t waitStart = 0, wakes = 0;
     //Infinitely loop
     while (1) {         
                
@@ -649,6 +1055,8 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
             //If the given operation is successful        
             if ((channel_list[indexChan].dir == SEND && status != CHANNEL_FULL) || (channel_list[indexChan].dir == RECV && status != CHANNEL_EMPTY)) {                 
                 *selected_index = indexChan;
+                //Count the wait on the channel that was used
+                stats_waited(channel_list[indexChan].channel, waitStart, wakes);
                 //Call helper function to clear channel                 
                 cleanup_channel(&mutex, &cond, channel_list, channel_count);
                 //Return its status                 
@@ -679,8 +1087,13 @@ enum channel_status channel_select(select_t* channel_list, size_t channel_count,
 
         //Unlock channel list
         unlock_channel(channel_list, channel_count); 
+        //Note when this select started blocking
+        if (waitStart == 0) {
+            waitStart = stats_now();
+        }
         //Wait for condition signal        
         pthread_cond_wait(&cond, &mutex);
+        wakes = wakes + 1;
         //Unlock mutex         
         pthread_mutex_unlock(&mutex);     
     } 
@@ -7,6 +7,7 @@
 #include <semaphore.h>
 #include "buffer.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 #include "linked_list.h"
@@ -35,6 +36,46 @@ enum channel_status {
     CHANNEL_OPEN = 4
 };
 
+// Direction of a channel operation
+enum direction {
+    SEND,
+    RECV,
+};
+
+// Callback run when a channel may have become ready for operations in direction dir
+// It runs with the channel locked, so it must not call back into the channel
+typedef void (*channel_ready_fn)(void* channel, enum direction dir, void* arg);
+
+// Number of cache-line-sized statistics shards per channel, must be a power of two
+// Each thread counts into the shard its id hashes to, which spreads the counter writes over
+// several lines; threads whose ids collide (always the case with more threads than shards) still share one
+#define CHANNEL_STATS_SHARDS 8
+
+// One shard of a channel's statistics, padded to a cache line of its own
+typedef struct {
+    uint64_t sends, receives, send_full, receive_empty;
+    uint64_t blocking_waits, wait_ns, wakeups, spurious_wakeups;
+} __attribute__((aligned(64))) channel_stats_shard_t;
+
+// Statistics of a channel, summed over all of its shards
+typedef struct {
+    //Messages sent and received, by any of the blocking, non-blocking, batch or select calls
+    uint64_t sends, receives;
+    
+    //Non-blocking calls that failed because the channel was full or empty
+    uint64_t send_full, receive_empty;
+    
+    //Operations that had to block, and the total nanoseconds they spent blocked
+    uint64_t blocking_waits, wait_ns;
+    
+    //Wakeups delivered to blocked operations, and the ones that found the channel still not ready
+    uint64_t wakeups, spurious_wakeups;
+    
+    //Most messages ever buffered at once
+    size_t peak_occupancy;
+    
+} channel_stats_t;
+
 // Defines channel object
 typedef struct {
     // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
@@ -62,13 +103,40 @@ typedef struct {
     //Keeps track of waiting
     int waitCon;
     
+    //Blocked senders are only woken once the buffer drains to lowWater items
+    //Batch receivers that don't ask for a batch size wait for highWater items
+    size_t lowWater, highWater;
+    
+    //Condition variable for batch receivers and the smallest batch any of them is waiting for
+    pthread_cond_t condBatch;
+    size_t batchNeed;
+    
+    //Number of batch receivers and blocking senders currently waiting
+    size_t batchWait, sendWait;
+    
+    //Readiness callback and its argument, NULL if nobody is listening
+    channel_ready_fn readyCallback;
+    void* readyArg;
+    
+    //Per-thread statistics shards and the most messages ever buffered
+    //Always present so the layout doesn't depend on CHANNEL_STATS, stats is NULL when it is compiled out
+    channel_stats_shard_t* stats;
+    size_t peakOcc;
+    
 } channel_t;
 
+// Defines channel creation attributes
+typedef struct {
+    //NUMA node for the channel's ring memory, or BUFFER_NUMA_ANY / BUFFER_NUMA_CURRENT
+    //Use BUFFER_NUMA_CURRENT from the consumer's thread to keep the ring local to the receiver
+    int numa_node;
+    
+    //Page backing for large rings (normal, transparent huge pages or explicit huge pages)
+    enum buffer_pages pages;
+    
+} channel_attr_t;
+
 // Defines channel list structure for channel_select function
-enum direction {
-    SEND,
-    RECV,
-};
 typedef struct {
     // Channel on which we want to perform operation
     channel_t* channel;
@@ -89,6 +157,13 @@ typedef struct {
 // Creates a new channel with the provided size and returns it to the caller
 channel_t* channel_create(size_t size);
 
+// Initializes attr with the defaults used by channel_create (no NUMA policy, normal pages)
+void channel_attr_init(channel_attr_t* attr);
+
+// Creates a new channel with the provided size whose ring memory follows attr and returns it to the caller
+// A NULL attr behaves exactly like channel_create
+channel_t* channel_create_attr(size_t size, const channel_attr_t* attr);
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -134,6 +209,35 @@ enum channel_status channel_close(channel_t* channel);
 // GENERIC_ERROR in any other error case
 enum channel_status channel_destroy(channel_t* channel);
 
+// Sets the flow control watermarks of a buffered channel
+// Senders blocked on a full channel are only woken once it drains to low items, and
+// channel_receive_batch calls with min_batch 0 wait until high items are buffered
+// The defaults (low = size - 1, high = 1) wake a waiter for every single item
+// Returns SUCCESS, or GENERIC_ERROR if the channel is unbuffered, low >= size, or high is 0 or larger than size
+enum channel_status channel_set_watermarks(channel_t* channel, size_t low, size_t high);
+
+// Reads up to max messages from the given channel into data and stores how many were read in count
+// This is a blocking call that waits until at least min_batch messages (or max, or the channel size,
+// whichever is smaller) are buffered, so a batch consumer is woken once per batch instead of once per item
+// A min_batch of 0 uses the channel's high watermark
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the channel is closed, and
+// GENERIC_ERROR if the channel is unbuffered or the arguments are invalid
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t max, size_t min_batch, size_t* count);
+
+// Registers callback to run (with arg) whenever a message is added to the channel (dir RECV),
+// a message is removed from it (dir SEND), or it is closed (both directions)
+// This lets an event loop drive many channels from a few threads with the non-blocking calls
+// A NULL callback removes the current one
+// Returns SUCCESS, or GENERIC_ERROR if the channel is NULL
+enum channel_status channel_set_ready_callback(channel_t* channel, channel_ready_fn callback, void* arg);
+
+// Stores the channel's statistics so far in stats
+// The counters are only kept when the library is built with CHANNEL_STATS (make CHANNEL_STATS=0 leaves them out)
+// They are read without stopping other threads, so a snapshot taken while the channel is busy may be slightly behind
+// Returns SUCCESS, or GENERIC_ERROR if an argument is NULL or the statistics were compiled out
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats);
+
 // Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
 // This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
 // If multiple options are available, it selects the first option and performs its corresponding action
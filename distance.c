@@ -0,0 +1,97 @@
+#include <string.h>
+#include "distance.h"
+
+// GCC vector extensions: 8 distance_t lanes per operation (AVX2 width, split on narrower targets)
+typedef distance_t distance_vec_t __attribute__((vector_size(32)));
+#define DISTANCE_LANES (sizeof(distance_vec_t) / sizeof(distance_t))
+
+void distance_min_plus(distance_t* restrict dst, const distance_t* restrict row, distance_t through, size_t n)
+{
+    if (through >= inf_distance) {
+        return;
+    }
+    size_t i = 0;
+    for (; i + DISTANCE_LANES <= n; i += DISTANCE_LANES) {
+        distance_vec_t current;
+        distance_vec_t candidate;
+        memcpy(&current, dst + i, sizeof(current));
+        memcpy(&candidate, row + i, sizeof(candidate));
+        candidate += through;
+        distance_vec_t better = (distance_vec_t)(candidate < current);
+        current = (candidate & better) | (current & ~better);
+        memcpy(dst + i, &current, sizeof(current));
+    }
+    for (; i < n; i++) {
+        distance_t candidate = row[i] + through;
+        if (candidate < dst[i]) {
+            dst[i] = candidate;
+        }
+    }
+}
+
+// Returns whether any lane of mask is set
+// mask is passed by pointer, a 32-byte vector argument has a GCC-version-dependent ABI
+static bool distance_any(const distance_vec_t* mask)
+{
+    distance_t any = 0;
+    for (size_t lane = 0; lane < DISTANCE_LANES; lane++) {
+        any |= (*mask)[lane];
+    }
+    return any != 0;
+}
+
+bool distance_merge(distance_t* restrict dst, const distance_t* restrict row, distance_t through, size_t n)
+{
+    if (through >= inf_distance) {
+        return false;
+    }
+    distance_vec_t inf = (distance_vec_t){0} + inf_distance;
+    distance_vec_t improved = {0};
+    size_t i = 0;
+    for (; i + DISTANCE_LANES <= n; i += DISTANCE_LANES) {
+        distance_vec_t current;
+        distance_vec_t candidate;
+        memcpy(&current, dst + i, sizeof(current));
+        memcpy(&candidate, row + i, sizeof(candidate));
+        candidate += through;
+        // through < inf_distance, so a sum that wrapped is below inf_distance only if it overflowed
+        distance_vec_t saturated = (distance_vec_t)(candidate > inf) | (distance_vec_t)(candidate < through);
+        candidate = (inf & saturated) | (candidate & ~saturated);
+        distance_vec_t better = (distance_vec_t)(candidate < current);
+        current = (candidate & better) | (current & ~better);
+        improved |= better;
+        memcpy(dst + i, &current, sizeof(current));
+    }
+    bool changed = distance_any(&improved);
+    for (; i < n; i++) {
+        distance_t candidate = row[i] + through;
+        if (candidate > inf_distance || candidate < through) {
+            candidate = inf_distance;
+        }
+        if (candidate < dst[i]) {
+            dst[i] = candidate;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool distance_copy(distance_t* restrict dst, const distance_t* restrict src, size_t n)
+{
+    distance_vec_t differ = {0};
+    size_t i = 0;
+    for (; i + DISTANCE_LANES <= n; i += DISTANCE_LANES) {
+        distance_vec_t old;
+        distance_vec_t value;
+        memcpy(&old, dst + i, sizeof(old));
+        memcpy(&value, src + i, sizeof(value));
+        differ |= old ^ value;
+        memcpy(dst + i, &value, sizeof(value));
+    }
+    bool changed = distance_any(&differ);
+    for (; i < n; i++) {
+        changed = changed || dst[i] != src[i];
+        dst[i] = src[i];
+    }
+    return changed;
+}
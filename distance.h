@@ -0,0 +1,24 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef unsigned int distance_t;
+
+// Every stored distance is at most inf_distance, so the sum of two distances
+// never wraps a distance_t and an unreachable sum never beats a stored value
+static const distance_t inf_distance = 0x7fffffff;
+
+// Relaxes dst[i] = min(dst[i], through + row[i]) for every i in [0, n)
+// dst and row must not overlap; nothing is done if through is inf_distance
+void distance_min_plus(distance_t* restrict dst, const distance_t* restrict row, distance_t through, size_t n);
+
+// Relaxes dst[i] = min(dst[i], through + row[i]) with the sum saturating at inf_distance,
+// so any through and row values are safe, and returns whether any dst[i] improved
+bool distance_merge(distance_t* restrict dst, const distance_t* restrict row, distance_t through, size_t n);
+
+// Copies n distances from src to dst and returns whether any of them differed
+bool distance_copy(distance_t* restrict dst, const distance_t* restrict src, size_t n);
+
+#endif // DISTANCE_H
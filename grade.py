@@ -80,6 +80,26 @@ add_test_cases("test_select_response_time", iters_one, timeout_response_time)
 add_test_cases("test_cpu_utilization_select", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_one, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
+add_test_cases("test_shared_channel", iters_slow)
+add_test_cases("test_journal_channel", iters_slow)
+add_test_cases("test_stream_channel", iters_slow)
+add_test_cases("test_channel_attr", iters_slow)
+add_test_cases("test_watermarks", iters_slow)
+add_test_cases("test_apsp", iters_slow, timeout_sanitize * 2)
+add_test_cases("test_topology_formats", iters_slow)
+add_test_cases("test_stress_pooled", iters_slow)
+add_test_cases("test_topology_generator", iters_slow)
+add_test_cases("test_stress_buffered", iters_slow)
+add_test_cases("test_distance_kernels", iters_slow)
+add_test_cases("test_stress_events", iters_slow)
+add_test_cases("test_solution_cache", iters_slow)
+add_test_cases("test_stress_placement", iters_slow)
+add_test_cases("test_stress_summary", iters_slow)
+add_test_cases("test_send_recv_bench", iters_slow)
+add_test_cases("test_send_recv_patterns", iters_slow)
+add_test_cases("test_stress_affinity", iters_slow)
+add_test_cases("test_latency_histogram", iters_slow)
+add_test_cases("test_channel_stats", iters_slow)
 
 # Score distribution
 point_breakdown = [
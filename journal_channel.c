@@ -0,0 +1,381 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "journal_channel.h"
+
+#define JOURNAL_MAGIC 0x4c4e524a4e484355ull // "UCHNJRNL"
+#define JOURNAL_HEADER sizeof(uint64_t)
+#define JOURNAL_SKIP UINT64_MAX
+#define JOURNAL_META_SIZE 4096
+
+// Records are 8-byte aligned so headers never straddle a word
+static size_t journal_record_size(size_t len)
+{
+    return (JOURNAL_HEADER + len + 7) & ~(size_t)7;
+}
+
+static void journal_path(journal_channel_t* channel, size_t index, char* path, size_t path_len)
+{
+    snprintf(path, path_len, "%s/%08zu.seg", channel->dir, index);
+}
+
+// msync the byte range [start, end) of a mapping, widening it to page boundaries
+static int journal_flush(unsigned char* base, size_t start, size_t end)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t aligned = start & ~(page - 1);
+    if (end <= start) {
+        return 0;
+    }
+    return msync(base + aligned, end - aligned, MS_SYNC);
+}
+
+static void journal_unmap(journal_channel_t* channel, journal_segment_t* segment)
+{
+    if (segment->base != NULL) {
+        munmap(segment->base, channel->segment_size);
+        segment->base = NULL;
+    }
+}
+
+// Makes segment map segment file index, creating the file if needed
+static int journal_map(journal_channel_t* channel, journal_segment_t* segment, size_t index)
+{
+    if (segment->base != NULL && segment->index == index) {
+        return 0;
+    }
+    journal_unmap(channel, segment);
+    char path[PATH_MAX];
+    journal_path(channel, index, path, sizeof(path));
+    int fd = open(path, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < channel->segment_size && ftruncate(fd, (off_t)channel->segment_size) != 0)) {
+        close(fd);
+        return -1;
+    }
+    void* addr = mmap(NULL, channel->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return -1;
+    }
+    segment->base = addr;
+    segment->index = index;
+    return 0;
+}
+
+static journal_meta_t* journal_map_meta(const char* dir, size_t segment_size)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/meta", dir);
+    int fd = open(path, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size < JOURNAL_META_SIZE && ftruncate(fd, JOURNAL_META_SIZE) != 0)) {
+        close(fd);
+        return NULL;
+    }
+    void* addr = mmap(NULL, JOURNAL_META_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+    journal_meta_t* meta = addr;
+    if (meta->magic != JOURNAL_MAGIC) {
+        meta->segment_size = segment_size;
+        meta->producer = 0;
+        meta->consumer = 0;
+        meta->magic = JOURNAL_MAGIC;
+        if (msync(addr, JOURNAL_META_SIZE, MS_SYNC) != 0) {
+            munmap(addr, JOURNAL_META_SIZE);
+            return NULL;
+        }
+    }
+    return meta;
+}
+
+journal_channel_t* channel_open_journal(const char* dir, size_t segment_size, size_t batch)
+{
+    if (dir == NULL || batch == 0 || segment_size < 2 * JOURNAL_HEADER || segment_size % JOURNAL_HEADER != 0) {
+        return NULL;
+    }
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+    journal_meta_t* meta = journal_map_meta(dir, segment_size);
+    if (meta == NULL) {
+        return NULL;
+    }
+    journal_channel_t* channel = malloc(sizeof(journal_channel_t));
+    if (channel == NULL) {
+        munmap(meta, JOURNAL_META_SIZE);
+        return NULL;
+    }
+    channel->dir = strdup(dir);
+    channel->segment_size = (size_t)meta->segment_size;
+    channel->batch = batch;
+    channel->meta = meta;
+    channel->writer.base = NULL;
+    channel->reader.base = NULL;
+    // anything past the committed producer offset was never made durable, so it is overwritten
+    channel->write_off = (size_t)meta->producer;
+    channel->commit_off = (size_t)meta->producer;
+    channel->read_off = (size_t)meta->consumer;
+    channel->ack_off = (size_t)meta->consumer;
+    channel->pending = 0;
+    channel->oldest_segment = channel->ack_off / channel->segment_size;
+    channel->closed = false;
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->readable, NULL);
+    return channel;
+}
+
+// Makes every appended record durable, then publishes the new producer offset
+// Must be called with the mutex held
+static int journal_commit(journal_channel_t* channel)
+{
+    if (channel->commit_off == channel->write_off) {
+        return 0;
+    }
+    // earlier segments were synced in full when the writer moved past them
+    size_t segment_start = channel->writer.index * channel->segment_size;
+    size_t start = channel->commit_off > segment_start ? channel->commit_off - segment_start : 0;
+    size_t end = channel->write_off - segment_start;
+    if (channel->writer.base != NULL && journal_flush(channel->writer.base, start, end) != 0) {
+        return -1;
+    }
+    channel->meta->producer = channel->write_off;
+    if (msync(channel->meta, JOURNAL_META_SIZE, MS_SYNC) != 0) {
+        return -1;
+    }
+    channel->commit_off = channel->write_off;
+    channel->pending = 0;
+    pthread_cond_broadcast(&channel->readable);
+    return 0;
+}
+
+enum channel_status channel_send_journal(journal_channel_t* channel, const void* data, size_t len)
+{
+    if (channel == NULL || (data == NULL && len != 0)) {
+        return GENERIC_ERROR;
+    }
+    size_t record = journal_record_size(len);
+    if (record > channel->segment_size) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    size_t offset = channel->write_off % channel->segment_size;
+    size_t skip = 0;
+    if (channel->segment_size - offset < record) {
+        // record does not fit in the rest of this segment, continue at the next one
+        skip = channel->segment_size - offset;
+    }
+    if (skip != 0) {
+        // write_off only moves past the marker once the next segment is ready, so a failed
+        // send leaves nothing for a receiver to commit
+        size_t segment = channel->write_off / channel->segment_size;
+        if (journal_map(channel, &channel->writer, segment) != 0) {
+            pthread_mutex_unlock(&channel->mutex);
+            return GENERIC_ERROR;
+        }
+        uint64_t marker = JOURNAL_SKIP;
+        memcpy(channel->writer.base + offset, &marker, sizeof(marker));
+        if (journal_flush(channel->writer.base, 0, channel->segment_size) != 0 ||
+            journal_map(channel, &channel->writer, segment + 1) != 0) {
+            pthread_mutex_unlock(&channel->mutex);
+            return GENERIC_ERROR;
+        }
+        channel->write_off += skip;
+        offset = 0;
+    }
+    size_t index = channel->write_off / channel->segment_size;
+    if (channel->writer.base != NULL && channel->writer.index != index &&
+        journal_flush(channel->writer.base, 0, channel->segment_size) != 0) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    if (journal_map(channel, &channel->writer, index) != 0) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    uint64_t header = len;
+    memcpy(channel->writer.base + offset, &header, sizeof(header));
+    if (len != 0) {
+        memcpy(channel->writer.base + offset + JOURNAL_HEADER, data, len);
+    }
+    channel->write_off += record;
+    channel->pending++;
+    if (channel->pending >= channel->batch && journal_commit(channel) != 0) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+static enum channel_status journal_receive(journal_channel_t* channel, void* data, size_t capacity, size_t* len, bool blocking)
+{
+    if (channel == NULL || len == NULL || (data == NULL && capacity != 0)) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    uint64_t header = 0;
+    size_t offset;
+    while (true) {
+        while (!channel->closed && channel->read_off == channel->commit_off) {
+            // polling never commits, or every poll would cost an msync while a batch fills up
+            if (!blocking) {
+                pthread_mutex_unlock(&channel->mutex);
+                return CHANNEL_EMPTY;
+            }
+            if (channel->write_off != channel->commit_off) {
+                // nothing committed yet but records are pending: flush them now instead of waiting for a full batch
+                if (journal_commit(channel) != 0) {
+                    pthread_mutex_unlock(&channel->mutex);
+                    return GENERIC_ERROR;
+                }
+                continue;
+            }
+            pthread_cond_wait(&channel->readable, &channel->mutex);
+        }
+        if (channel->closed) {
+            pthread_mutex_unlock(&channel->mutex);
+            return CLOSED_ERROR;
+        }
+        offset = channel->read_off % channel->segment_size;
+        if (journal_map(channel, &channel->reader, channel->read_off / channel->segment_size) != 0) {
+            pthread_mutex_unlock(&channel->mutex);
+            return GENERIC_ERROR;
+        }
+        memcpy(&header, channel->reader.base + offset, sizeof(header));
+        if (header != JOURNAL_SKIP) {
+            break;
+        }
+        // the record after the marker may not be committed yet, so check again before reading it
+        channel->read_off += channel->segment_size - offset;
+    }
+    if (header > capacity) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    *len = (size_t)header;
+    if (header != 0) {
+        memcpy(data, channel->reader.base + offset + JOURNAL_HEADER, (size_t)header);
+    }
+    channel->read_off += journal_record_size((size_t)header);
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_receive_journal(journal_channel_t* channel, void* data, size_t capacity, size_t* len)
+{
+    return journal_receive(channel, data, capacity, len, true);
+}
+
+enum channel_status channel_non_blocking_receive_journal(journal_channel_t* channel, void* data, size_t capacity, size_t* len)
+{
+    return journal_receive(channel, data, capacity, len, false);
+}
+
+enum channel_status channel_ack_journal(journal_channel_t* channel)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    channel->ack_off = channel->read_off;
+    channel->meta->consumer = channel->ack_off;
+    if (msync(channel->meta, JOURNAL_META_SIZE, MS_SYNC) != 0) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    // segments entirely before the acknowledged offset can never be replayed again
+    size_t ack_segment = channel->ack_off / channel->segment_size;
+    for (; channel->oldest_segment < ack_segment; channel->oldest_segment++) {
+        char path[PATH_MAX];
+        journal_path(channel, channel->oldest_segment, path, sizeof(path));
+        unlink(path);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_sync_journal(journal_channel_t* channel)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    int status = journal_commit(channel);
+    pthread_mutex_unlock(&channel->mutex);
+    return status == 0 ? SUCCESS : GENERIC_ERROR;
+}
+
+enum channel_status channel_close_journal(journal_channel_t* channel)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    int status = journal_commit(channel);
+    channel->closed = true;
+    pthread_cond_broadcast(&channel->readable);
+    pthread_mutex_unlock(&channel->mutex);
+    return status == 0 ? SUCCESS : GENERIC_ERROR;
+}
+
+enum channel_status channel_destroy_journal(journal_channel_t* channel)
+{
+    if (channel == NULL || !channel->closed) {
+        return DESTROY_ERROR;
+    }
+    journal_unmap(channel, &channel->writer);
+    journal_unmap(channel, &channel->reader);
+    munmap(channel->meta, JOURNAL_META_SIZE);
+    pthread_cond_destroy(&channel->readable);
+    pthread_mutex_destroy(&channel->mutex);
+    free(channel->dir);
+    free(channel);
+    return SUCCESS;
+}
+
+enum channel_status channel_remove_journal(const char* dir)
+{
+    if (dir == NULL) {
+        return GENERIC_ERROR;
+    }
+    DIR* handle = opendir(dir);
+    if (handle == NULL) {
+        return GENERIC_ERROR;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t name_len = strlen(entry->d_name);
+        bool segment = name_len > 4 && strcmp(entry->d_name + name_len - 4, ".seg") == 0;
+        if (segment || strcmp(entry->d_name, "meta") == 0) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(handle);
+    return rmdir(dir) == 0 ? SUCCESS : GENERIC_ERROR;
+}
@@ -0,0 +1,90 @@
+#ifndef JOURNAL_CHANNEL_H
+#define JOURNAL_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "channel.h"
+
+// Persisted offsets of a journal, kept in <dir>/meta and msync'd on every commit/ack
+typedef struct {
+    uint64_t magic;
+    uint64_t segment_size;
+    // end of the last group-committed record
+    uint64_t producer;
+    // end of the last acknowledged record, replay starts here on reopen
+    uint64_t consumer;
+} journal_meta_t;
+
+// A single mapped segment file <dir>/<index>.seg
+typedef struct {
+    size_t index;
+    unsigned char* base;
+} journal_segment_t;
+
+// Durable channel whose messages are appended to memory-mapped, fixed-size log segments
+// Offsets are logical byte positions across all segments (segment = offset / segment_size)
+typedef struct {
+    char* dir;
+    size_t segment_size;
+    // number of appended records that triggers a group commit
+    size_t batch;
+    journal_meta_t* meta;
+    journal_segment_t writer;
+    journal_segment_t reader;
+    size_t write_off;
+    size_t commit_off;
+    size_t read_off;
+    size_t ack_off;
+    size_t pending;
+    size_t oldest_segment;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t readable;
+} journal_channel_t;
+
+// Opens the journal stored in dir, creating it if it does not exist
+// segment_size is only used for a new journal; an existing journal keeps its own
+// Records appended but not yet committed when the process died are discarded, and
+// every committed record that was not acknowledged is delivered again
+// Returns NULL on any error
+journal_channel_t* channel_open_journal(const char* dir, size_t segment_size, size_t batch);
+
+// Appends len bytes of data as one record
+// The record becomes visible to receivers once it is group-committed (every batch records,
+// on channel_sync_journal, or when a receiver would otherwise block)
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR if the record
+// does not fit in a segment or cannot be written
+enum channel_status channel_send_journal(journal_channel_t* channel, const void* data, size_t len);
+
+// Copies the next committed record into data (at most capacity bytes) and stores its length in len
+// Waits while no committed record is available
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR if the record is larger
+// than capacity (the record is not consumed in that case)
+enum channel_status channel_receive_journal(journal_channel_t* channel, void* data, size_t capacity, size_t* len);
+
+// Non-blocking variant of channel_receive_journal
+// Returns CHANNEL_EMPTY instead of waiting; it never forces a group commit, so records
+// appended since the last commit stay invisible to it until the batch fills or channel_sync_journal
+enum channel_status channel_non_blocking_receive_journal(journal_channel_t* channel, void* data, size_t capacity, size_t* len);
+
+// Durably acknowledges every record received so far; acknowledged records are never replayed
+// and fully acknowledged segments are deleted
+enum channel_status channel_ack_journal(journal_channel_t* channel);
+
+// Forces a group commit of every record appended so far
+enum channel_status channel_sync_journal(journal_channel_t* channel);
+
+// Commits pending records and informs blocked receivers to return with CLOSED_ERROR
+// Unacknowledged records stay in the journal for the next channel_open_journal
+enum channel_status channel_close_journal(journal_channel_t* channel);
+
+// Unmaps the journal and frees the handle; the files stay on disk
+// Returns DESTROY_ERROR if the channel has not been closed
+enum channel_status channel_destroy_journal(journal_channel_t* channel);
+
+// Deletes every file of the journal stored in dir along with the directory itself
+enum channel_status channel_remove_journal(const char* dir);
+
+#endif // JOURNAL_CHANNEL_H
@@ -0,0 +1,79 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+
+void latency_reset(latency_histogram_t* histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void latency_record_atomic(latency_histogram_t* histogram, uint64_t ns)
+{
+    // the counters are independent, so relaxed ordering is enough until the histogram is read
+    __atomic_fetch_add(&histogram->buckets[latency_bucket(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->total_ns, ns, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+    // a failed exchange reloads max
+    bool stored = false;
+    while (ns > max && !stored) {
+        stored = __atomic_compare_exchange_n(&histogram->max_ns, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+}
+
+void latency_merge(latency_histogram_t* into, const latency_histogram_t* from)
+{
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        into->buckets[bucket] += from->buckets[bucket];
+    }
+    into->count += from->count;
+    into->total_ns += from->total_ns;
+    into->max_ns = (from->max_ns > into->max_ns) ? from->max_ns : into->max_ns;
+}
+
+uint64_t latency_bucket_max(size_t bucket)
+{
+    if (bucket < (2u << LATENCY_SUB_BITS)) {
+        return bucket;
+    }
+    size_t shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t mantissa = bucket - (shift << LATENCY_SUB_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+uint64_t latency_percentile(const latency_histogram_t* histogram, double q)
+{
+    uint64_t total = histogram->count;
+    uint64_t rank = (uint64_t)((double)total * q);
+    rank = (rank < total) ? rank + 1 : total;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank && seen != 0) {
+            // the bucket bound may lie above the largest latency actually counted
+            uint64_t bound = latency_bucket_max(bucket);
+            return (bound < histogram->max_ns) ? bound : histogram->max_ns;
+        }
+    }
+    return 0;
+}
+
+void latency_summarize(latency_summary_t* summary, const latency_histogram_t* histogram)
+{
+    summary->count = histogram->count;
+    summary->mean_ns = (histogram->count == 0) ? 0 : histogram->total_ns / histogram->count;
+    summary->p50_ns = latency_percentile(histogram, 0.5);
+    summary->p90_ns = latency_percentile(histogram, 0.9);
+    summary->p99_ns = latency_percentile(histogram, 0.99);
+    summary->p999_ns = latency_percentile(histogram, 0.999);
+    summary->max_ns = histogram->max_ns;
+}
+
+void latency_print(const char* name, const latency_summary_t* summary)
+{
+    printf("%s: %llu samples, mean %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n", name,
+           (unsigned long long)summary->count, (double)summary->mean_ns / 1e3, (double)summary->p50_ns / 1e3,
+           (double)summary->p90_ns / 1e3, (double)summary->p99_ns / 1e3, (double)summary->p999_ns / 1e3,
+           (double)summary->max_ns / 1e3);
+}
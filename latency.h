@@ -0,0 +1,71 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Latencies are counted in log-linear buckets (HDR style): exact below 64ns, then 32 buckets per
+// power of two (about 3% wide), so recording is a few instructions and percentiles need no samples
+#define LATENCY_SUB_BITS 5
+#define LATENCY_BUCKETS (64 << LATENCY_SUB_BITS)
+
+// Zero-initialize (or latency_reset) before use
+// Give each thread its own histogram and merge them at the end, or share one and record with
+// latency_record_atomic
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+// Percentiles of a histogram, each the upper bound of the bucket holding it
+typedef struct {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} latency_summary_t;
+
+void latency_reset(latency_histogram_t* histogram);
+
+// Returns the bucket counting a latency
+static inline size_t latency_bucket(uint64_t ns)
+{
+    if (ns < (2u << LATENCY_SUB_BITS)) {
+        return (size_t)ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS;
+    return ((size_t)shift << LATENCY_SUB_BITS) + (size_t)(ns >> shift);
+}
+
+// Counts one latency; only one thread may record into a histogram this way
+static inline void latency_record(latency_histogram_t* histogram, uint64_t ns)
+{
+    histogram->buckets[latency_bucket(ns)]++;
+    histogram->count++;
+    histogram->total_ns += ns;
+    histogram->max_ns = (ns > histogram->max_ns) ? ns : histogram->max_ns;
+}
+
+// Counts one latency into a histogram shared between threads
+void latency_record_atomic(latency_histogram_t* histogram, uint64_t ns);
+
+// Adds the counts of from to into (which nobody may be recording into)
+void latency_merge(latency_histogram_t* into, const latency_histogram_t* from);
+
+// Returns the largest latency counted in a bucket
+uint64_t latency_bucket_max(size_t bucket);
+
+// Returns the latency below which a share q of the counted latencies fall (0 if there are none)
+uint64_t latency_percentile(const latency_histogram_t* histogram, double q);
+
+void latency_summarize(latency_summary_t* summary, const latency_histogram_t* histogram);
+
+// Prints a summary in microseconds as one line starting with name
+void latency_print(const char* name, const latency_summary_t* summary);
+
+#endif // LATENCY_H
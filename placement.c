@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "placement.h"
+
+// Reads a single integer from a sysfs file, or returns fallback if there is none
+static int placement_read_int(const char* path, int fallback)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return fallback;
+    }
+    int value;
+    if (fscanf(file, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(file);
+    return value;
+}
+
+// Parses a sysfs CPU list ("0-3,8,10-11") into a cpu_set_t
+static bool placement_read_list(const char* path, cpu_set_t* set)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    CPU_ZERO(set);
+    int first, last;
+    char separator;
+    bool valid = true;
+    while (valid && fscanf(file, "%d", &first) == 1) {
+        last = first;
+        int read = fscanf(file, "%c", &separator);
+        if (read == 1 && separator == '-') {
+            valid = fscanf(file, "%d", &last) == 1;
+            read = fscanf(file, "%c", &separator);
+        }
+        for (int cpu = first; valid && cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET((size_t)cpu, set);
+        }
+        if (read != 1 || separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return valid;
+}
+
+bool cpu_topology_load(cpu_topology_t* topology)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return false;
+    }
+    topology->count = (size_t)CPU_COUNT(&allowed);
+    topology->cpus = malloc(sizeof(cpu_info_t) * topology->count);
+    if (topology->cpus == NULL) {
+        return false;
+    }
+    char path[128];
+    size_t count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < topology->count; cpu++) {
+        if (!CPU_ISSET((size_t)cpu, &allowed)) {
+            continue;
+        }
+        cpu_info_t* info = &topology->cpus[count++];
+        info->cpu = cpu;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        info->core = placement_read_int(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        info->package = placement_read_int(path, 0);
+        info->node = 0;
+    }
+    // the nodes list their CPUs, not the other way round
+    cpu_set_t nodes;
+    if (placement_read_list("/sys/devices/system/node/online", &nodes)) {
+        for (int node = 0; node < CPU_SETSIZE; node++) {
+            cpu_set_t node_cpus;
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (!CPU_ISSET((size_t)node, &nodes) || !placement_read_list(path, &node_cpus)) {
+                continue;
+            }
+            for (size_t i = 0; i < topology->count; i++) {
+                if (CPU_ISSET((size_t)topology->cpus[i].cpu, &node_cpus)) {
+                    topology->cpus[i].node = node;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void cpu_topology_free(cpu_topology_t* topology)
+{
+    free(topology->cpus);
+    topology->cpus = NULL;
+    topology->count = 0;
+}
+
+static const char* placement_mode_names[] = {"none", "core", "node"};
+
+const char* placement_mode_name(enum placement_mode mode)
+{
+    if ((size_t)mode >= sizeof(placement_mode_names) / sizeof(placement_mode_names[0])) {
+        return NULL;
+    }
+    return placement_mode_names[mode];
+}
+
+bool placement_mode_parse(const char* name, enum placement_mode* mode)
+{
+    for (size_t i = 0; i < sizeof(placement_mode_names) / sizeof(placement_mode_names[0]); i++) {
+        if (strcmp(name, placement_mode_names[i]) == 0) {
+            *mode = (enum placement_mode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool placement_partition(size_t* part, const topology_csr_t* csr, size_t parts)
+{
+    size_t n = csr->n;
+    size_t* queue = malloc(sizeof(size_t) * (n + 1));
+    size_t* size = calloc(parts, sizeof(size_t));
+    size_t* links_to = calloc(parts, sizeof(size_t));
+    if (queue == NULL || size == NULL || links_to == NULL) {
+        free(queue);
+        free(size);
+        free(links_to);
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        part[i] = SIZE_MAX;
+    }
+    // grow each part breadth-first, so it takes routers close to each other
+    size_t seed = 0;
+    for (size_t p = 0; p < parts; p++) {
+        size_t capacity = n / parts + (p < n % parts);
+        size_t head = 0;
+        size_t tail = 0;
+        while (size[p] < capacity) {
+            if (head == tail) {
+                // the part's frontier is exhausted (or it just started), continue from a new seed
+                while (part[seed] != SIZE_MAX) {
+                    seed++;
+                }
+                part[seed] = p;
+                size[p]++;
+                queue[tail++] = seed;
+                continue;
+            }
+            size_t v = queue[head++];
+            for (size_t e = csr->offsets[v]; e < csr->offsets[v + 1] && size[p] < capacity; e++) {
+                size_t w = csr->neighbors[e];
+                if (part[w] == SIZE_MAX) {
+                    part[w] = p;
+                    size[p]++;
+                    queue[tail++] = w;
+                }
+            }
+        }
+    }
+    // refine: every move strictly reduces the cut, so the passes terminate
+    size_t slack = n / parts / 32 + 1;
+    size_t largest = (n + parts - 1) / parts + slack;
+    size_t smallest = (n / parts > slack) ? n / parts - slack : 0;
+    for (int pass = 0; pass < 8; pass++) {
+        size_t moved = 0;
+        for (size_t v = 0; v < n; v++) {
+            size_t from = part[v];
+            for (size_t e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+                if (csr->neighbors[e] != v) {
+                    links_to[part[csr->neighbors[e]]]++;
+                }
+            }
+            size_t best = from;
+            if (size[from] > smallest) {
+                for (size_t e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+                    size_t q = part[csr->neighbors[e]];
+                    if (size[q] < largest && links_to[q] > links_to[best]) {
+                        best = q;
+                    }
+                }
+            }
+            for (size_t e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+                links_to[part[csr->neighbors[e]]] = 0;
+            }
+            if (best != from) {
+                part[v] = best;
+                size[from]--;
+                size[best]++;
+                moved++;
+            }
+        }
+        if (moved == 0) {
+            break;
+        }
+    }
+    free(queue);
+    free(size);
+    free(links_to);
+    return true;
+}
+
+size_t placement_cut(const size_t* part, const topology_csr_t* csr)
+{
+    size_t cut = 0;
+    for (size_t v = 0; v < csr->n; v++) {
+        for (size_t e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            cut += part[csr->neighbors[e]] != part[v];
+        }
+    }
+    return cut;
+}
+
+bool placement_create(placement_t* placement, const topology_csr_t* csr, enum placement_mode mode, size_t max_parts)
+{
+    cpu_topology_t topology;
+    if (mode == PLACEMENT_NONE || csr->n == 0 || !cpu_topology_load(&topology)) {
+        return false;
+    }
+    size_t count = topology.count;
+    // group the CPUs into units (cores or nodes) in order of their first CPU
+    size_t* unit = malloc(sizeof(size_t) * count);
+    placement->cpus = malloc(sizeof(int) * count);
+    placement->part = malloc(sizeof(size_t) * csr->n);
+    placement->cpu_offsets = malloc(sizeof(size_t) * (count + 1));
+    bool valid = unit != NULL && placement->cpus != NULL && placement->part != NULL && placement->cpu_offsets != NULL;
+    size_t units = 0;
+    for (size_t i = 0; valid && i < count; i++) {
+        cpu_info_t* info = &topology.cpus[i];
+        unit[i] = units;
+        for (size_t j = 0; j < i; j++) {
+            cpu_info_t* other = &topology.cpus[j];
+            bool same = (mode == PLACEMENT_NODE) ? other->node == info->node
+                                                 : other->package == info->package && other->core == info->core;
+            if (same) {
+                unit[i] = unit[j];
+                break;
+            }
+        }
+        units += unit[i] == units;
+    }
+    size_t parts = units;
+    if (max_parts != 0 && parts > max_parts) {
+        parts = max_parts;
+    }
+    if (parts > csr->n) {
+        parts = csr->n;
+    }
+    placement->parts = parts;
+    if (valid) {
+        // unit u runs part u % parts
+        size_t next = 0;
+        for (size_t p = 0; p < parts; p++) {
+            placement->cpu_offsets[p] = next;
+            for (size_t i = 0; i < count; i++) {
+                if (unit[i] % parts == p) {
+                    placement->cpus[next++] = topology.cpus[i].cpu;
+                }
+            }
+        }
+        placement->cpu_offsets[parts] = next;
+        valid = placement_partition(placement->part, csr, parts);
+    }
+    free(unit);
+    cpu_topology_free(&topology);
+    if (!valid) {
+        placement_free(placement);
+    }
+    return valid;
+}
+
+void placement_free(placement_t* placement)
+{
+    free(placement->part);
+    free(placement->cpu_offsets);
+    free(placement->cpus);
+    placement->part = NULL;
+    placement->cpu_offsets = NULL;
+    placement->cpus = NULL;
+    placement->parts = 0;
+}
+
+bool placement_pin(pthread_t thread, const placement_t* placement, size_t part)
+{
+    size_t first = (part == SIZE_MAX) ? 0 : placement->cpu_offsets[part];
+    size_t last = (part == SIZE_MAX) ? placement->cpu_offsets[placement->parts] : placement->cpu_offsets[part + 1];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = first; i < last; i++) {
+        CPU_SET((size_t)placement->cpus[i], &set);
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+static const char* affinity_policy_names[] = {"none", "compact", "scatter", "smt-pairs", "cross-socket"};
+
+const char* affinity_policy_name(enum affinity_policy policy)
+{
+    if ((size_t)policy >= sizeof(affinity_policy_names) / sizeof(affinity_policy_names[0])) {
+        return NULL;
+    }
+    return affinity_policy_names[policy];
+}
+
+bool affinity_policy_parse(const char* name, enum affinity_policy* policy)
+{
+    for (size_t i = 0; i < sizeof(affinity_policy_names) / sizeof(affinity_policy_names[0]); i++) {
+        if (strcmp(name, affinity_policy_names[i]) == 0) {
+            *policy = (enum affinity_policy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+enum affinity_policy affinity_policy_from_env(void)
+{
+    enum affinity_policy policy = AFFINITY_NONE;
+    const char* name = getenv("STRESS_AFFINITY");
+    if (name != NULL && !affinity_policy_parse(name, &policy)) {
+        fprintf(stderr, "Unknown STRESS_AFFINITY %s, threads are not pinned\n", name);
+    }
+    return policy;
+}
+
+// A CPU with the sort keys of a policy, most significant first
+typedef struct {
+    size_t key[4];
+    int cpu;
+} affinity_slot_t;
+
+static int affinity_compare(const void* a, const void* b)
+{
+    const affinity_slot_t* left = a;
+    const affinity_slot_t* right = b;
+    for (size_t k = 0; k < 4; k++) {
+        if (left->key[k] != right->key[k]) {
+            return (left->key[k] < right->key[k]) ? -1 : 1;
+        }
+    }
+    return (left->cpu > right->cpu) - (left->cpu < right->cpu);
+}
+
+bool affinity_order(int* cpus, const cpu_topology_t* topology, enum affinity_policy policy)
+{
+    size_t count = topology->count;
+    affinity_slot_t* slots = malloc(sizeof(affinity_slot_t) * count);
+    // the first CPU (index) of every CPU's package and core
+    size_t* first_package = malloc(sizeof(size_t) * count);
+    size_t* first_core = malloc(sizeof(size_t) * count);
+    bool valid = slots != NULL && first_package != NULL && first_core != NULL;
+    for (size_t i = 0; valid && i < count; i++) {
+        const cpu_info_t* info = &topology->cpus[i];
+        first_package[i] = i;
+        first_core[i] = i;
+        for (size_t j = i; j-- > 0;) {
+            if (topology->cpus[j].package == info->package) {
+                first_package[i] = j;
+                if (topology->cpus[j].core == info->core) {
+                    first_core[i] = j;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; valid && i < count; i++) {
+        // rank the package, the core within its package and the CPU within its core by their first CPU
+        size_t package = 0;
+        size_t core = 0;
+        size_t sibling = 0;
+        for (size_t j = 0; j < i; j++) {
+            package += first_package[j] == j && j < first_package[i];
+            core += first_core[j] == j && j < first_core[i] && first_package[j] == first_package[i];
+            sibling += first_core[j] == first_core[i];
+        }
+        slots[i].cpu = topology->cpus[i].cpu;
+        switch (policy) {
+        case AFFINITY_SCATTER:
+            memcpy(slots[i].key, (size_t[4]){sibling, core, package, 0}, sizeof(slots[i].key));
+            break;
+        case AFFINITY_SMT_PAIRS:
+            memcpy(slots[i].key, (size_t[4]){sibling / 2, core, package, sibling % 2}, sizeof(slots[i].key));
+            break;
+        case AFFINITY_CROSS_SOCKET:
+            memcpy(slots[i].key, (size_t[4]){core, sibling, package, 0}, sizeof(slots[i].key));
+            break;
+        default:
+            memcpy(slots[i].key, (size_t[4]){package, core, sibling, 0}, sizeof(slots[i].key));
+            break;
+        }
+    }
+    if (valid) {
+        qsort(slots, count, sizeof(affinity_slot_t), affinity_compare);
+        for (size_t i = 0; i < count; i++) {
+            cpus[i] = slots[i].cpu;
+        }
+    }
+    free(slots);
+    free(first_package);
+    free(first_core);
+    return valid;
+}
+
+bool affinity_create(affinity_t* affinity, enum affinity_policy policy)
+{
+    cpu_topology_t topology;
+    if (policy == AFFINITY_NONE || !cpu_topology_load(&topology)) {
+        return false;
+    }
+    affinity->policy = policy;
+    affinity->count = topology.count;
+    affinity->cpus = malloc(sizeof(int) * topology.count);
+    bool valid = affinity->cpus != NULL && affinity_order(affinity->cpus, &topology, policy);
+    cpu_topology_free(&topology);
+    if (!valid) {
+        affinity_free(affinity);
+    }
+    return valid;
+}
+
+void affinity_free(affinity_t* affinity)
+{
+    free(affinity->cpus);
+    affinity->cpus = NULL;
+    affinity->count = 0;
+}
+
+int affinity_cpu(const affinity_t* affinity, size_t thread)
+{
+    return affinity->cpus[thread % affinity->count];
+}
+
+bool affinity_pin(pthread_t thread, const affinity_t* affinity, size_t i)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((size_t)affinity_cpu(affinity, i), &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+void affinity_describe(const affinity_t* affinity, size_t threads, char* text)
+{
+    size_t used = 0;
+    text[0] = '\0';
+    for (size_t i = 0; affinity != NULL && i < threads; i++) {
+        char cpu[16];
+        int len = snprintf(cpu, sizeof(cpu), (i == 0) ? "%d" : ";%d", affinity_cpu(affinity, i));
+        // keep room for "..." and the terminator
+        if (len < 0 || used + (size_t)len + 4 > AFFINITY_DESCRIPTION) {
+            strcpy(text + used, "...");
+            return;
+        }
+        memcpy(text + used, cpu, (size_t)len + 1);
+        used += (size_t)len;
+    }
+}
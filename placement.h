@@ -0,0 +1,131 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "topology.h"
+
+// A logical CPU the process may run on, with where it sits in the machine
+typedef struct {
+    int cpu;
+    // physical core within the package (SMT siblings share it)
+    int core;
+    int package;
+    // NUMA node
+    int node;
+} cpu_info_t;
+
+typedef struct {
+    size_t count;
+    // sorted by cpu
+    cpu_info_t* cpus;
+} cpu_topology_t;
+
+// Reads the CPUs in the process' affinity mask and their core, package and NUMA node from sysfs
+// (missing sysfs entries count as core, package and node 0)
+bool cpu_topology_load(cpu_topology_t* topology);
+
+void cpu_topology_free(cpu_topology_t* topology);
+
+enum placement_mode {
+    // threads run wherever the scheduler puts them
+    PLACEMENT_NONE,
+    // one part per physical core, pinned to its SMT siblings
+    PLACEMENT_CORE,
+    // one part per NUMA node, pinned to the node's CPUs
+    PLACEMENT_NODE,
+};
+
+// Which part every router belongs to, and the CPUs each part runs on:
+// part p runs on cpus[cpu_offsets[p] .. cpu_offsets[p + 1])
+typedef struct {
+    size_t parts;
+    size_t* part;
+    size_t* cpu_offsets;
+    int* cpus;
+} placement_t;
+
+// Returns the name of a placement mode, or NULL for an unknown mode
+const char* placement_mode_name(enum placement_mode mode);
+
+// Parses a placement mode name ("none", "core", "node"); returns false for an unknown name
+bool placement_mode_parse(const char* name, enum placement_mode* mode);
+
+// Splits the n routers of csr into parts of (nearly) equal size while cutting as few links as possible:
+// greedy graph growing from the lowest unassigned router, then refinement passes that move a router
+// to the part holding most of its links as long as the parts stay balanced
+// part has n entries; returns false if out of memory
+bool placement_partition(size_t* part, const topology_csr_t* csr, size_t parts);
+
+// Returns the number of links between routers of different parts
+size_t placement_cut(const size_t* part, const topology_csr_t* csr);
+
+// Partitions the routers into one part per core or NUMA node of the CPUs this process may use,
+// merging cores/nodes round-robin if there are more than max_parts (0 for no limit) or routers
+// Returns false if the CPUs can't be read or out of memory (mode must not be PLACEMENT_NONE)
+bool placement_create(placement_t* placement, const topology_csr_t* csr, enum placement_mode mode, size_t max_parts);
+
+void placement_free(placement_t* placement);
+
+// Restricts a thread to the CPUs of a part (SIZE_MAX for the CPUs of every part)
+// Returns false if the affinity could not be set
+bool placement_pin(pthread_t thread, const placement_t* placement, size_t part);
+
+// How benchmark threads are pinned, one CPU each: thread i runs on the i-th CPU of the policy's
+// order, wrapping around when there are more threads than CPUs
+enum affinity_policy {
+    // threads run wherever the scheduler puts them
+    AFFINITY_NONE,
+    // fill the SMT siblings of a core, then the next core of the package, then the next package
+    AFFINITY_COMPACT,
+    // one thread per physical core, alternating packages; SMT siblings once every core has a thread
+    AFFINITY_SCATTER,
+    // threads 2k and 2k + 1 share a core (as SMT siblings), consecutive pairs alternate packages
+    AFFINITY_SMT_PAIRS,
+    // consecutive threads alternate packages, each package filled compactly
+    AFFINITY_CROSS_SOCKET,
+};
+
+// Longest description written by affinity_describe, including the terminator
+#define AFFINITY_DESCRIPTION 256
+
+typedef struct {
+    enum affinity_policy policy;
+    // the CPUs this process may use, in the policy's order
+    size_t count;
+    int* cpus;
+} affinity_t;
+
+// Returns the name of an affinity policy, or NULL for an unknown policy
+const char* affinity_policy_name(enum affinity_policy policy);
+
+// Parses an affinity policy name ("none", "compact", "scatter", "smt-pairs", "cross-socket")
+bool affinity_policy_parse(const char* name, enum affinity_policy* policy);
+
+// Returns the policy named by STRESS_AFFINITY, which the benchmarks use by default, or AFFINITY_NONE
+// if it is not set (or unknown)
+enum affinity_policy affinity_policy_from_env(void);
+
+// Stores the CPUs of topology in the policy's order in cpus (topology->count entries)
+// Returns false if out of memory
+bool affinity_order(int* cpus, const cpu_topology_t* topology, enum affinity_policy policy);
+
+// Orders the CPUs this process may use for the policy
+// Returns false if the CPUs can't be read or out of memory (policy must not be AFFINITY_NONE)
+bool affinity_create(affinity_t* affinity, enum affinity_policy policy);
+
+void affinity_free(affinity_t* affinity);
+
+// Returns the CPU thread i runs on
+int affinity_cpu(const affinity_t* affinity, size_t thread);
+
+// Restricts a thread to the CPU of thread i
+// Returns false if the affinity could not be set
+bool affinity_pin(pthread_t thread, const affinity_t* affinity, size_t i);
+
+// Writes the CPUs of the first threads as "cpu;cpu;..." into text (AFFINITY_DESCRIPTION bytes),
+// ending with "..." if they don't fit; affinity may be NULL for threads that are not pinned ("")
+void affinity_describe(const affinity_t* affinity, size_t threads, char* text);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "stress_send_recv.h"
+
+#define MAX_VALUES 32
+
+static int usage(const char* program)
+{
+    printf("Usage: %s [-p patterns] [-a affinities] [-b buffers] [-t threads] [-l loads] [-s stages] [-d duration_ms]\n", program);
+    printf("  Runs the benchmark for every combination of the comma-separated values and prints\n");
+    printf("  one CSV row per run; defaults are -p ring -a $STRESS_AFFINITY or none -b 1 -t 4 -l 0.5 -s 4 -d 1000\n");
+    printf("  patterns: ring, fan-in, fan-out, all-to-all, pipeline (-s only applies to pipelines)\n");
+    printf("  affinities: none, compact, scatter, smt-pairs, cross-socket (worker i gets the i-th CPU)\n");
+    printf("  combinations a pattern does not support (e.g. fan-in with one thread) are skipped\n");
+    printf("  e.g. %s -b 1,16 -t 1,2,4,8,16,32 charts the scaling curve of both buffer sizes\n", program);
+    return 1;
+}
+
+// Parses a comma-separated list of positive numbers
+static bool parse_list(const char* text, double* values, size_t* count)
+{
+    *count = 0;
+    while (*count < MAX_VALUES) {
+        char* end;
+        values[*count] = strtod(text, &end);
+        if (end == text || values[*count] <= 0) {
+            return false;
+        }
+        (*count)++;
+        if (*end == '\0') {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        text = end + 1;
+    }
+    return false;
+}
+
+// Parses a comma-separated list of pattern names, or of affinity policy names if affinities is set
+static bool parse_names(const char* text, enum send_recv_pattern* patterns, enum affinity_policy* affinities, size_t* count)
+{
+    char name[32];
+    *count = 0;
+    while (*count < MAX_VALUES) {
+        size_t len = strcspn(text, ",");
+        if (len >= sizeof(name)) {
+            return false;
+        }
+        memcpy(name, text, len);
+        name[len] = '\0';
+        bool valid = (affinities != NULL) ? affinity_policy_parse(name, &affinities[*count])
+                                          : send_recv_pattern_parse(name, &patterns[*count]);
+        if (!valid) {
+            return false;
+        }
+        (*count)++;
+        if (text[len] == '\0') {
+            return true;
+        }
+        text += len + 1;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    enum send_recv_pattern patterns[MAX_VALUES] = {SEND_RECV_RING};
+    size_t pattern_count = 1;
+    // no -a keeps the default of send_recv_options_init
+    enum affinity_policy affinities[MAX_VALUES];
+    size_t affinity_count = 0;
+    double stages = 4;
+    double buffers[MAX_VALUES] = {1};
+    double threads[MAX_VALUES] = {4};
+    double loads[MAX_VALUES] = {0.5};
+    size_t buffer_count = 1;
+    size_t thread_count = 1;
+    size_t load_count = 1;
+    double duration_ms = 1000;
+    for (int i = 1; i < argc; i += 2) {
+        size_t count;
+        bool valid = i + 1 < argc;
+        if (valid && strcmp(argv[i], "-p") == 0) {
+            valid = parse_names(argv[i + 1], patterns, NULL, &pattern_count);
+        } else if (valid && strcmp(argv[i], "-a") == 0) {
+            valid = parse_names(argv[i + 1], NULL, affinities, &affinity_count);
+        } else if (valid && strcmp(argv[i], "-b") == 0) {
+            valid = parse_list(argv[i + 1], buffers, &buffer_count);
+        } else if (valid && strcmp(argv[i], "-t") == 0) {
+            valid = parse_list(argv[i + 1], threads, &thread_count);
+        } else if (valid && strcmp(argv[i], "-l") == 0) {
+            valid = parse_list(argv[i + 1], loads, &load_count);
+        } else if (valid && strcmp(argv[i], "-s") == 0) {
+            valid = parse_list(argv[i + 1], &stages, &count) && count == 1;
+        } else if (valid && strcmp(argv[i], "-d") == 0) {
+            valid = parse_list(argv[i + 1], &duration_ms, &count) && count == 1;
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            return usage(argv[0]);
+        }
+    }
+    size_t affinity_runs = (affinity_count == 0) ? 1 : affinity_count;
+    print_send_recv_header();
+    for (size_t p = 0; p < pattern_count; p++) {
+        for (size_t a = 0; a < affinity_runs; a++) {
+            for (size_t b = 0; b < buffer_count; b++) {
+                for (size_t t = 0; t < thread_count; t++) {
+                    for (size_t l = 0; l < load_count; l++) {
+                        send_recv_options_t options;
+                        send_recv_options_init(&options);
+                        options.pattern = patterns[p];
+                        if (affinity_count != 0) {
+                            options.affinity = affinities[a];
+                        }
+                        options.buffer_size = (size_t)buffers[b];
+                        options.num_threads = (size_t)threads[t];
+                        options.stages = (size_t)stages;
+                        options.load = loads[l];
+                        options.duration_usec = (useconds_t)(duration_ms * 1e3);
+                        if (!send_recv_options_valid(&options)) {
+                            fprintf(stderr, "skipping %s with %zu threads, load %.3f\n",
+                                    send_recv_pattern_name(options.pattern), options.num_threads, options.load);
+                            continue;
+                        }
+                        send_recv_result_t result;
+                        run_send_recv(&options, &result);
+                        print_send_recv_result(&options, &result);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
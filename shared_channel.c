@@ -0,0 +1,273 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shared_channel.h"
+
+#define SHARED_CHANNEL_MAGIC 0x43484e53u // "CHNS"
+
+// Parks the caller until *word no longer holds expected (or a wakeup arrives)
+// The futex is not FUTEX_PRIVATE so waiters in other processes mapping the same region are found
+static void futex_wait(atomic_uint* word, unsigned int expected)
+{
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+// Wakes up to count waiters parked on word
+static void futex_wake(atomic_uint* word, int count)
+{
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+// Locks the region, recovering the mutex if its previous owner process died while holding it
+// head/count are only updated after a payload copy completes, so the ring is consistent either way
+static int shared_lock(shared_region_t* region)
+{
+    int status = pthread_mutex_lock(&region->mutex);
+    if (status == EOWNERDEAD) {
+        status = pthread_mutex_consistent(&region->mutex);
+    }
+    return status;
+}
+
+shared_channel_t* channel_create_shared(const char* name, size_t size, size_t msg_size)
+{
+    if (name == NULL || size == 0 || msg_size == 0) {
+        return NULL;
+    }
+    if (msg_size > (SIZE_MAX - sizeof(shared_region_t)) / size) {
+        return NULL;
+    }
+    size_t map_size = sizeof(shared_region_t) + size * msg_size;
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)map_size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    void* addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // ftruncate zero-fills the region, so counters and futex words already start at 0
+    shared_region_t* region = addr;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int status = pthread_mutex_init(&region->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (status != 0) {
+        munmap(addr, map_size);
+        shm_unlink(name);
+        return NULL;
+    }
+    region->capacity = size;
+    region->msg_size = msg_size;
+    atomic_store(&region->magic, SHARED_CHANNEL_MAGIC);
+
+    shared_channel_t* channel = malloc(sizeof(shared_channel_t));
+    if (channel == NULL) {
+        munmap(addr, map_size);
+        shm_unlink(name);
+        return NULL;
+    }
+    channel->region = region;
+    channel->map_size = map_size;
+    return channel;
+}
+
+shared_channel_t* channel_open_shared(const char* name)
+{
+    if (name == NULL) {
+        return NULL;
+    }
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shared_region_t)) {
+        close(fd);
+        return NULL;
+    }
+    size_t map_size = (size_t)st.st_size;
+    void* addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    shared_region_t* region = addr;
+    if (atomic_load(&region->magic) != SHARED_CHANNEL_MAGIC ||
+        map_size != sizeof(shared_region_t) + region->capacity * region->msg_size) {
+        munmap(addr, map_size);
+        return NULL;
+    }
+
+    shared_channel_t* channel = malloc(sizeof(shared_channel_t));
+    if (channel == NULL) {
+        munmap(addr, map_size);
+        return NULL;
+    }
+    channel->region = region;
+    channel->map_size = map_size;
+    return channel;
+}
+
+static enum channel_status shared_send(shared_channel_t* channel, const void* msg, bool blocking)
+{
+    if (channel == NULL || msg == NULL) {
+        return GENERIC_ERROR;
+    }
+    shared_region_t* region = channel->region;
+    if (shared_lock(region) != 0) {
+        return GENERIC_ERROR;
+    }
+    while (!atomic_load(&region->closed) && region->count == region->capacity) {
+        if (!blocking) {
+            pthread_mutex_unlock(&region->mutex);
+            return CHANNEL_FULL;
+        }
+        // sample the futex word under the lock so a wakeup issued after we unlock is not lost
+        unsigned int seq = atomic_load(&region->not_full);
+        region->send_waiting++;
+        pthread_mutex_unlock(&region->mutex);
+        futex_wait(&region->not_full, seq);
+        if (shared_lock(region) != 0) {
+            return GENERIC_ERROR;
+        }
+        region->send_waiting--;
+    }
+    if (atomic_load(&region->closed)) {
+        pthread_mutex_unlock(&region->mutex);
+        return CLOSED_ERROR;
+    }
+    size_t pos = region->head + region->count;
+    if (pos >= region->capacity) {
+        pos -= region->capacity;
+    }
+    memcpy(&region->ring[pos * region->msg_size], msg, region->msg_size);
+    region->count++;
+    if (region->recv_waiting > 0) {
+        atomic_fetch_add(&region->not_empty, 1);
+        futex_wake(&region->not_empty, 1);
+    }
+    pthread_mutex_unlock(&region->mutex);
+    return SUCCESS;
+}
+
+static enum channel_status shared_receive(shared_channel_t* channel, void* msg, bool blocking)
+{
+    if (channel == NULL || msg == NULL) {
+        return GENERIC_ERROR;
+    }
+    shared_region_t* region = channel->region;
+    if (shared_lock(region) != 0) {
+        return GENERIC_ERROR;
+    }
+    while (!atomic_load(&region->closed) && region->count == 0) {
+        if (!blocking) {
+            pthread_mutex_unlock(&region->mutex);
+            return CHANNEL_EMPTY;
+        }
+        unsigned int seq = atomic_load(&region->not_empty);
+        region->recv_waiting++;
+        pthread_mutex_unlock(&region->mutex);
+        futex_wait(&region->not_empty, seq);
+        if (shared_lock(region) != 0) {
+            return GENERIC_ERROR;
+        }
+        region->recv_waiting--;
+    }
+    if (atomic_load(&region->closed)) {
+        pthread_mutex_unlock(&region->mutex);
+        return CLOSED_ERROR;
+    }
+    memcpy(msg, &region->ring[region->head * region->msg_size], region->msg_size);
+    region->count--;
+    region->head++;
+    if (region->head >= region->capacity) {
+        region->head -= region->capacity;
+    }
+    if (region->send_waiting > 0) {
+        atomic_fetch_add(&region->not_full, 1);
+        futex_wake(&region->not_full, 1);
+    }
+    pthread_mutex_unlock(&region->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_send_shared(shared_channel_t* channel, const void* msg)
+{
+    return shared_send(channel, msg, true);
+}
+
+enum channel_status channel_receive_shared(shared_channel_t* channel, void* msg)
+{
+    return shared_receive(channel, msg, true);
+}
+
+enum channel_status channel_non_blocking_send_shared(shared_channel_t* channel, const void* msg)
+{
+    return shared_send(channel, msg, false);
+}
+
+enum channel_status channel_non_blocking_receive_shared(shared_channel_t* channel, void* msg)
+{
+    return shared_receive(channel, msg, false);
+}
+
+enum channel_status channel_close_shared(shared_channel_t* channel)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    shared_region_t* region = channel->region;
+    if (shared_lock(region) != 0) {
+        return GENERIC_ERROR;
+    }
+    if (atomic_load(&region->closed)) {
+        pthread_mutex_unlock(&region->mutex);
+        return CLOSED_ERROR;
+    }
+    atomic_store(&region->closed, 1);
+    atomic_fetch_add(&region->not_empty, 1);
+    atomic_fetch_add(&region->not_full, 1);
+    futex_wake(&region->not_empty, INT_MAX);
+    futex_wake(&region->not_full, INT_MAX);
+    pthread_mutex_unlock(&region->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_destroy_shared(shared_channel_t* channel)
+{
+    if (channel == NULL) {
+        return DESTROY_ERROR;
+    }
+    if (munmap(channel->region, channel->map_size) != 0) {
+        return DESTROY_ERROR;
+    }
+    free(channel);
+    return SUCCESS;
+}
+
+enum channel_status channel_unlink_shared(const char* name)
+{
+    if (name == NULL || shm_unlink(name) != 0) {
+        return GENERIC_ERROR;
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,76 @@
+#ifndef SHARED_CHANNEL_H
+#define SHARED_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "channel.h"
+
+// Layout of a shared channel inside its shm_open/mmap region
+// Everything a peer process needs (ring, state and parking words) lives here,
+// so the region must not contain any process-local pointers
+typedef struct {
+    // set last during creation so openers can tell the region is ready
+    atomic_uint magic;
+    // non-zero once channel_close_shared has been called by any process
+    atomic_uint closed;
+    // futex words, bumped whenever a parked receiver/sender should re-check
+    atomic_uint not_empty;
+    atomic_uint not_full;
+    // number of processes/threads parked on each futex word
+    unsigned int recv_waiting;
+    unsigned int send_waiting;
+    // process-shared, robust lock protecting head/count
+    pthread_mutex_t mutex;
+    size_t capacity;
+    size_t msg_size;
+    size_t head;
+    size_t count;
+    // capacity * msg_size bytes of inline message payloads
+    unsigned char ring[];
+} shared_region_t;
+
+// Process-local handle to a mapped shared channel
+typedef struct {
+    shared_region_t* region;
+    size_t map_size;
+} shared_channel_t;
+
+// Creates a new named shared channel holding up to size messages of msg_size bytes each
+// Messages are copied into and out of the shared ring by value
+// Returns NULL if the name already exists, size or msg_size is zero, or the region cannot be created
+shared_channel_t* channel_create_shared(const char* name, size_t size, size_t msg_size);
+
+// Maps an existing named shared channel created by this or another process
+// Returns NULL if the channel does not exist or its creator has not finished initializing it
+shared_channel_t* channel_open_shared(const char* name);
+
+// Copies msg_size bytes from msg into the channel, waiting while the channel is full
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR
+enum channel_status channel_send_shared(shared_channel_t* channel, const void* msg);
+
+// Copies the oldest message into msg, waiting while the channel is empty
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR
+enum channel_status channel_receive_shared(shared_channel_t* channel, void* msg);
+
+// Non-blocking variant of channel_send_shared
+// Returns CHANNEL_FULL instead of waiting
+enum channel_status channel_non_blocking_send_shared(shared_channel_t* channel, const void* msg);
+
+// Non-blocking variant of channel_receive_shared
+// Returns CHANNEL_EMPTY instead of waiting
+enum channel_status channel_non_blocking_receive_shared(shared_channel_t* channel, void* msg);
+
+// Closes the channel for every process that has it mapped and wakes all parked senders/receivers
+// Returns SUCCESS, or CLOSED_ERROR if the channel is already closed
+enum channel_status channel_close_shared(shared_channel_t* channel);
+
+// Unmaps the channel from this process and frees the local handle
+// The shared region itself stays alive until channel_unlink_shared is called and every process has unmapped it
+enum channel_status channel_destroy_shared(shared_channel_t* channel);
+
+// Removes the name of a shared channel so no new process can open it
+enum channel_status channel_unlink_shared(const char* name);
+
+#endif // SHARED_CHANNEL_H
@@ -0,0 +1,151 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "solution_cache.h"
+#include "apsp.h"
+
+// FNV-1a, one 32-bit word at a time
+static uint64_t solution_cache_mix(uint64_t hash, uint64_t word)
+{
+    return (hash ^ word) * 0x100000001b3ull;
+}
+
+uint64_t solution_cache_key(const topology_csr_t* csr)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = solution_cache_mix(hash, csr->n);
+    for (size_t src = 0; src < csr->n; src++) {
+        // the row length keeps rows from running into each other
+        hash = solution_cache_mix(hash, csr->offsets[src + 1] - csr->offsets[src]);
+        for (size_t e = csr->offsets[src]; e < csr->offsets[src + 1]; e++) {
+            hash = solution_cache_mix(hash, csr->neighbors[e]);
+            hash = solution_cache_mix(hash, csr->weights[e]);
+        }
+    }
+    return hash;
+}
+
+const char* solution_cache_dir(void)
+{
+    const char* dir = getenv("SOLUTION_CACHE_DIR");
+    if (dir == NULL) {
+        return SOLUTION_CACHE_DEFAULT_DIR;
+    }
+    return dir[0] == '\0' ? NULL : dir;
+}
+
+static void solution_cache_path(char* path, size_t size, const char* dir, uint64_t hash)
+{
+    snprintf(path, size, "%s/%016llx.sol", dir, (unsigned long long)hash);
+}
+
+static void solution_cache_header(solution_cache_header_t* header, const topology_csr_t* csr, uint64_t hash)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SOLUTION_CACHE_MAGIC, sizeof(header->magic));
+    header->n = csr->n;
+    header->edges = csr->edges;
+    header->hash = hash;
+}
+
+// Maps a cache file if it holds the solution of a topology with this header
+static bool solution_cache_map(solution_t* solution, const char* path, const solution_cache_header_t* expected)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    size_t n = (size_t)expected->n;
+    size_t size = sizeof(solution_cache_header_t) + sizeof(distance_t) * n * n;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+        close(fd);
+        return false;
+    }
+    // private and writable, so the solution can be updated in place without touching the file
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    if (memcmp(addr, expected, sizeof(solution_cache_header_t)) != 0) {
+        munmap(addr, size);
+        return false;
+    }
+    solution->n = n;
+    solution->distances = (distance_t*)((char*)addr + sizeof(solution_cache_header_t));
+    solution->mapping = addr;
+    solution->mapping_size = size;
+    return true;
+}
+
+// Writes the file under a temporary name and renames it into place, so concurrent runs
+// never map a partially written solution
+static void solution_cache_store(const solution_t* solution, const char* dir, const char* path,
+                                 const solution_cache_header_t* header)
+{
+    mkdir(dir, 0755);
+    char temp[4096];
+    if (snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(temp)) {
+        return;
+    }
+    FILE* file = fopen(temp, "wb");
+    if (file == NULL) {
+        return;
+    }
+    size_t count = solution->n * solution->n;
+    bool valid = fwrite(header, sizeof(*header), 1, file) == 1 &&
+                 fwrite(solution->distances, sizeof(distance_t), count, file) == count;
+    valid = (fclose(file) == 0) && valid;
+    if (!valid || rename(temp, path) != 0) {
+        unlink(temp);
+    }
+}
+
+bool solution_cache_load(solution_t* solution, const topology_csr_t* csr, const char* dir)
+{
+    size_t n = csr->n;
+    solution_cache_header_t header;
+    char path[4096];
+    if (dir != NULL) {
+        uint64_t hash = solution_cache_key(csr);
+        solution_cache_header(&header, csr, hash);
+        solution_cache_path(path, sizeof(path), dir, hash);
+        if (solution_cache_map(solution, path, &header)) {
+            return true;
+        }
+    }
+    if (n > (SIZE_MAX / sizeof(distance_t)) / (n == 0 ? 1 : n)) {
+        return false;
+    }
+    solution->n = n;
+    solution->distances = malloc(sizeof(distance_t) * n * n);
+    solution->mapping = NULL;
+    solution->mapping_size = 0;
+    if (solution->distances == NULL) {
+        return false;
+    }
+    // the solver needs the dense matrix, so expand the links into the solution and solve in place
+    topology_csr_to_dense(csr, solution->distances);
+    apsp_solve(solution->distances, solution->distances, n);
+    if (dir != NULL) {
+        solution_cache_store(solution, dir, path, &header);
+    }
+    return true;
+}
+
+void solution_free(solution_t* solution)
+{
+    if (solution->mapping != NULL) {
+        munmap(solution->mapping, solution->mapping_size);
+    } else {
+        free(solution->distances);
+    }
+    solution->distances = NULL;
+    solution->mapping = NULL;
+    solution->mapping_size = 0;
+}
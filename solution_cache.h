@@ -0,0 +1,50 @@
+#ifndef SOLUTION_CACHE_H
+#define SOLUTION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "distance.h"
+#include "topology.h"
+
+// Cached solutions are stored as <dir>/<hash>.sol: this header followed by the n * n
+// row-major all-pairs distances, so a hit maps the file and uses the distances in place
+// (bump the version in the magic whenever the solver's output changes)
+#define SOLUTION_CACHE_MAGIC "CHSOLN1"
+
+// Cache directory used when SOLUTION_CACHE_DIR is not set (an empty SOLUTION_CACHE_DIR disables the cache)
+#define SOLUTION_CACHE_DEFAULT_DIR ".solution_cache"
+
+typedef struct {
+    char magic[8];
+    uint64_t n;
+    uint64_t edges;
+    uint64_t hash;
+} solution_cache_header_t;
+
+typedef struct {
+    size_t n;
+    // row-major n x n shortest distances
+    distance_t* distances;
+    // non-NULL when distances points into a (private, writable) mapping of a cache file
+    void* mapping;
+    size_t mapping_size;
+} solution_t;
+
+// Hashes the contents of a topology; the CSR form is canonical, so every file format of the same
+// topology hashes the same
+uint64_t solution_cache_key(const topology_csr_t* csr);
+
+// Returns the cache directory from SOLUTION_CACHE_DIR (or the default), or NULL if caching is disabled
+const char* solution_cache_dir(void);
+
+// Loads the all-pairs solution of csr: a cached solution in dir is mapped, otherwise the solution is
+// computed and stored in dir for later runs (dir NULL only computes it)
+// A missing, stale or truncated cache file counts as a miss; failing to store the solution is not an error
+// Returns false if there isn't enough memory to compute the solution
+bool solution_cache_load(solution_t* solution, const topology_csr_t* csr, const char* dir);
+
+// Releases the memory or mapping behind a solution
+void solution_free(solution_t* solution);
+
+#endif // SOLUTION_CACHE_H
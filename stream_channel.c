@@ -0,0 +1,241 @@
+#include <string.h>
+#include "stream_channel.h"
+
+stream_channel_t* channel_create_stream(size_t size)
+{
+    // frames are 4-byte aligned, so the ring is too
+    size_t capacity = (size + 3) & ~(size_t)3;
+    if (capacity < 2 * STREAM_FRAME_HEADER) {
+        return NULL;
+    }
+    stream_channel_t* channel = malloc(sizeof(stream_channel_t));
+    if (channel == NULL) {
+        return NULL;
+    }
+    channel->ring = malloc(capacity);
+    if (channel->ring == NULL) {
+        free(channel);
+        return NULL;
+    }
+    channel->capacity = capacity;
+    channel->head = 0;
+    channel->used = 0;
+    channel->data_end = capacity;
+    channel->closed = false;
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->readable, NULL);
+    pthread_cond_init(&channel->writable, NULL);
+    return channel;
+}
+
+// Returns the bytes a new frame of record bytes would take, including a skipped tail if the
+// frame has to wrap, and stores the size of that skipped tail in skip
+static size_t stream_needed(stream_channel_t* channel, size_t record, size_t* skip)
+{
+    size_t tail = channel->head + channel->used;
+    if (tail >= channel->capacity) {
+        tail -= channel->capacity;
+    }
+    *skip = 0;
+    // only unwrapped data can wrap again; wrapped data always grows towards head
+    bool wrapped = channel->used > 0 && tail <= channel->head;
+    if (!wrapped && record > channel->capacity - tail) {
+        *skip = channel->capacity - tail;
+    }
+    return *skip + record;
+}
+
+// Frees n bytes of frames at the head, jumping over the skipped tail once head reaches it
+static void stream_release(stream_channel_t* channel, size_t n)
+{
+    while (n > 0) {
+        size_t first = channel->data_end - channel->head;
+        if (n < first) {
+            channel->head += n;
+            channel->used -= n;
+            n = 0;
+        } else {
+            n -= first;
+            channel->used -= first + (channel->capacity - channel->data_end);
+            channel->head = 0;
+            channel->data_end = channel->capacity;
+        }
+    }
+    if (channel->used == 0) {
+        // restart at the beginning so the next frame never needs to wrap
+        channel->head = 0;
+        channel->data_end = channel->capacity;
+    }
+    pthread_cond_broadcast(&channel->writable);
+}
+
+static enum channel_status stream_write(stream_channel_t* channel, const void* data, size_t len, bool blocking)
+{
+    if (channel == NULL || (data == NULL && len != 0) || len >= STREAM_SKIP) {
+        return GENERIC_ERROR;
+    }
+    size_t record = stream_frame_size(len);
+    if (record > channel->capacity) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    size_t skip;
+    while (!channel->closed && stream_needed(channel, record, &skip) > channel->capacity - channel->used) {
+        if (!blocking) {
+            pthread_mutex_unlock(&channel->mutex);
+            return CHANNEL_FULL;
+        }
+        pthread_cond_wait(&channel->writable, &channel->mutex);
+    }
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    size_t tail = channel->head + channel->used;
+    if (tail >= channel->capacity) {
+        tail -= channel->capacity;
+    }
+    if (skip != 0) {
+        uint32_t marker = STREAM_SKIP;
+        memcpy(channel->ring + tail, &marker, sizeof(marker));
+        channel->data_end = tail;
+        channel->used += skip;
+        tail = 0;
+    }
+    uint32_t header = (uint32_t)len;
+    memcpy(channel->ring + tail, &header, sizeof(header));
+    if (len != 0) {
+        memcpy(channel->ring + tail + STREAM_FRAME_HEADER, data, len);
+    }
+    channel->used += record;
+    pthread_cond_signal(&channel->readable);
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_write_frame(stream_channel_t* channel, const void* data, size_t len)
+{
+    return stream_write(channel, data, len, true);
+}
+
+enum channel_status channel_non_blocking_write_frame(stream_channel_t* channel, const void* data, size_t len)
+{
+    return stream_write(channel, data, len, false);
+}
+
+static enum channel_status stream_read(stream_channel_t* channel, void* data, size_t capacity, size_t* len, bool blocking)
+{
+    if (channel == NULL || len == NULL || (data == NULL && capacity != 0)) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    while (!channel->closed && channel->used == 0) {
+        if (!blocking) {
+            pthread_mutex_unlock(&channel->mutex);
+            return CHANNEL_EMPTY;
+        }
+        pthread_cond_wait(&channel->readable, &channel->mutex);
+    }
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    uint32_t header;
+    memcpy(&header, channel->ring + channel->head, sizeof(header));
+    if (header > capacity) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    *len = header;
+    if (header != 0) {
+        memcpy(data, channel->ring + channel->head + STREAM_FRAME_HEADER, header);
+    }
+    stream_release(channel, stream_frame_size(header));
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_read_frame(stream_channel_t* channel, void* data, size_t capacity, size_t* len)
+{
+    return stream_read(channel, data, capacity, len, true);
+}
+
+enum channel_status channel_non_blocking_read_frame(stream_channel_t* channel, void* data, size_t capacity, size_t* len)
+{
+    return stream_read(channel, data, capacity, len, false);
+}
+
+enum channel_status channel_peek_stream(stream_channel_t* channel, struct iovec spans[2], size_t* count)
+{
+    if (channel == NULL || spans == NULL || count == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    while (!channel->closed && channel->used == 0) {
+        pthread_cond_wait(&channel->readable, &channel->mutex);
+    }
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    size_t first = channel->data_end - channel->head;
+    if (first > channel->used) {
+        first = channel->used;
+    }
+    spans[0].iov_base = channel->ring + channel->head;
+    spans[0].iov_len = first;
+    *count = 1;
+    if (channel->used > first) {
+        spans[1].iov_base = channel->ring;
+        spans[1].iov_len = channel->used - first - (channel->capacity - channel->data_end);
+        *count = 2;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_consume_stream(stream_channel_t* channel, size_t bytes)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    size_t gap = (channel->used > channel->data_end - channel->head) ? channel->capacity - channel->data_end : 0;
+    if (bytes > channel->used - gap) {
+        pthread_mutex_unlock(&channel->mutex);
+        return GENERIC_ERROR;
+    }
+    stream_release(channel, bytes);
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_close_stream(stream_channel_t* channel)
+{
+    if (channel == NULL) {
+        return GENERIC_ERROR;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (channel->closed) {
+        pthread_mutex_unlock(&channel->mutex);
+        return CLOSED_ERROR;
+    }
+    channel->closed = true;
+    pthread_cond_broadcast(&channel->readable);
+    pthread_cond_broadcast(&channel->writable);
+    pthread_mutex_unlock(&channel->mutex);
+    return SUCCESS;
+}
+
+enum channel_status channel_destroy_stream(stream_channel_t* channel)
+{
+    if (channel == NULL || !channel->closed) {
+        return DESTROY_ERROR;
+    }
+    pthread_cond_destroy(&channel->readable);
+    pthread_cond_destroy(&channel->writable);
+    pthread_mutex_destroy(&channel->mutex);
+    free(channel->ring);
+    free(channel);
+    return SUCCESS;
+}
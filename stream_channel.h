@@ -0,0 +1,79 @@
+#ifndef STREAM_CHANNEL_H
+#define STREAM_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include "channel.h"
+
+// Every frame starts with a 4-byte length header and is padded to a 4-byte boundary
+// A header holding STREAM_SKIP marks the unused tail of the ring before the writer wrapped
+#define STREAM_FRAME_HEADER sizeof(uint32_t)
+#define STREAM_SKIP UINT32_MAX
+
+// Byte-stream channel storing length-prefixed frames contiguously in a byte ring
+// A frame is never split across the end of the ring
+typedef struct {
+    unsigned char* ring;
+    size_t capacity;
+    // offset of the oldest frame
+    size_t head;
+    // bytes occupied by frames and by the skipped tail (if the data wraps)
+    size_t used;
+    // where the data before the wrap ends (capacity if the data does not wrap)
+    size_t data_end;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+} stream_channel_t;
+
+// Returns the bytes a frame of len payload bytes occupies in the ring
+static inline size_t stream_frame_size(size_t len)
+{
+    return (STREAM_FRAME_HEADER + len + 3) & ~(size_t)3;
+}
+
+// Creates a byte-stream channel with a ring of (at least) size bytes
+stream_channel_t* channel_create_stream(size_t size);
+
+// Copies len bytes of data into the ring as one frame, waiting while there is not enough space
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR if the frame can never fit
+enum channel_status channel_write_frame(stream_channel_t* channel, const void* data, size_t len);
+
+// Non-blocking variant of channel_write_frame
+// Returns CHANNEL_FULL instead of waiting
+enum channel_status channel_non_blocking_write_frame(stream_channel_t* channel, const void* data, size_t len);
+
+// Copies the oldest frame into data (at most capacity bytes) and stores its length in len
+// Waits while the channel is empty
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, or GENERIC_ERROR if the frame is larger
+// than capacity (the frame is not consumed in that case)
+enum channel_status channel_read_frame(stream_channel_t* channel, void* data, size_t capacity, size_t* len);
+
+// Non-blocking variant of channel_read_frame
+// Returns CHANNEL_EMPTY instead of waiting
+enum channel_status channel_non_blocking_read_frame(stream_channel_t* channel, void* data, size_t capacity, size_t* len);
+
+// Zero-copy read: waits for data, then describes every buffered frame in place with up to two spans
+// (the frames before the wrap and the frames after it) and stores the number of spans in count
+// Each span is a sequence of whole frames, so it can be parsed with stream_frame_size()
+// The memory stays valid until channel_consume_stream is called; only one thread may peek/consume at a time
+// Returns SUCCESS or CLOSED_ERROR if the channel is closed
+enum channel_status channel_peek_stream(stream_channel_t* channel, struct iovec spans[2], size_t* count);
+
+// Releases bytes of frames previously returned by channel_peek_stream
+// bytes must end on a frame boundary; the skipped tail between the two spans is released automatically
+// Returns SUCCESS or GENERIC_ERROR if more bytes are released than are buffered
+enum channel_status channel_consume_stream(stream_channel_t* channel, size_t bytes);
+
+// Closes the channel and informs all blocked writers/readers to return with CLOSED_ERROR
+enum channel_status channel_close_stream(stream_channel_t* channel);
+
+// Frees all the memory allocated to the channel
+// Returns DESTROY_ERROR if the channel has not been closed
+enum channel_status channel_destroy_stream(stream_channel_t* channel);
+
+#endif // STREAM_CHANNEL_H
@@ -2,31 +2,139 @@
 #include <pthread.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
 #include "channel.h"
 #include "stress.h"
+#include "apsp.h"
+#include "topology.h"
+#include "solution_cache.h"
+#include "placement.h"
 
-typedef unsigned int distance_t;
+typedef struct {
+    uint32_t dest;
+    distance_t dist;
+} distance_delta_t;
+
+// A broadcast only carries the destinations that improved since the router's previous broadcast
+// Every neighbor merges every broadcast, so together they describe the router's whole distance vector
+// Updates are reference counted (one reference per neighbor plus one held by the router while it is
+// being broadcast), so any number of them can be queued in a channel
+// Once a large share of the vector changed, the whole vector is sent instead (dist is not NULL),
+// and merged with the vectorized kernel
 typedef struct {
     size_t src;
     size_t epoch;
-    distance_t dist[0];
-} distance_vector_t;
+    atomic_size_t refs;
+    distance_t* dist;
+    size_t delta_count;
+    distance_delta_t deltas[];
+} distance_update_t;
+
+// an update is sent dense once at least 1 / DENSE_UPDATE_RATIO of the destinations changed
+#define DENSE_UPDATE_RATIO 4
+
+// one broadcast of a router, for the per-epoch time series
+typedef struct {
+    size_t epoch;
+    uint64_t time_ns;
+    // destinations carried (every destination for a dense update)
+    size_t destinations;
+} epoch_sample_t;
+
+// scheduling states of a router in pooled mode
+enum router_schedule {
+    ROUTER_IDLE,
+    ROUTER_QUEUED,
+    ROUTER_RUNNING,
+    // an event arrived while running, so run again before going idle
+    ROUTER_RERUN,
+};
 
-static const distance_t inf_distance = 0x7fffffff;
-static distance_t* topology;
+// pooled mode: routers ready to run, each queued at most once
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;
+    size_t* queue;
+    size_t head;
+    size_t count;
+    bool stop;
+} run_queue_t;
+
+typedef struct {
+    size_t index;
+    size_t neighbor_count;
+    bool changed;
+    size_t epoch;
+    // best known distances and the distances as of the last broadcast
+    distance_t* dist;
+    distance_t* sent;
+    // destinations that improved since the last broadcast, unless a dense merge changed
+    // destinations that aren't listed (then the next broadcast is dense)
+    uint32_t* changed_dests;
+    size_t changed_count;
+    bool dense_pending;
+    // the update being broadcast
+    distance_update_t* update;
+    // instrumentation, read by the coordinator once the network is quiescent or the router stopped:
+    // updates merged (and merges that improved nothing), updates sent, time spent in channel_select
+    // (threaded mode) and sends that found the channel full (pooled mode)
+    size_t merged;
+    size_t noop_merges;
+    size_t messages_sent;
+    uint64_t blocked_ns;
+    size_t send_stalls;
+    // one sample per broadcast when a time series is recorded
+    epoch_sample_t* samples;
+    size_t sample_count;
+    size_t sample_capacity;
+    // pooled mode: next link of the current broadcast, the channel a full send is waiting for
+    // (SIZE_MAX if none) and the scheduling state
+    size_t next_link;
+    atomic_size_t blocked_on;
+    atomic_int schedule;
+    // the queue of the workers running this router's part
+    run_queue_t* run_queue;
+} router_t;
+
+static topology_csr_t links;
+// the reference solution, mapped from the solution cache when the topology was solved before
+static solution_t reference;
 static distance_t* solution;
 static size_t num_channel;
 static channel_t** channels;
 static channel_t* done_channel;
 static channel_t* completed_channel;
+static router_t* routers;
+// termination detection: updates that have been (or are about to be) sent but not yet merged
+// a router reserves the messages of its next broadcast before it retires the message that caused it,
+// so the count only reaches zero once the network is quiescent
+static atomic_size_t in_flight;
+static topology_csr_t reverse_links;
+// one run queue per part when the routers are placed, otherwise a single one
+static run_queue_t* run_queues;
+static size_t run_queue_count;
+// control messages the coordinator injects after an event, recognised by their address:
+// a reset drops everything the router learned, a resend makes it broadcast its whole vector again
+static distance_update_t reset_message;
+static distance_update_t resend_message;
+// the time series clock starts with the first router thread
+static struct timespec run_start;
+static bool record_series;
 
-distance_t get_link_distance(size_t src, size_t dst) {
-    return topology[src * num_channel + dst];
+// Returns the nanoseconds since the run started
+uint64_t elapsed_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - run_start.tv_sec) * 1000000000ull + (uint64_t)now.tv_nsec - (uint64_t)run_start.tv_nsec;
 }
 
-void set_link_distance(size_t src, size_t dst, distance_t distance) {
-    topology[src * num_channel + dst] = distance;
+distance_t get_link_distance(size_t src, size_t dst) {
+    return topology_csr_weight(&links, src, dst);
 }
 
 distance_t get_solution_distance(size_t src, size_t dst) {
@@ -37,20 +145,6 @@ void set_solution_distance(size_t src, size_t dst, distance_t distance) {
     solution[src * num_channel + dst] = distance;
 }
 
-void floyd_warshall()
-{
-    memcpy(solution, topology, sizeof(distance_t) * num_channel * num_channel);
-    for (size_t intermediate = 0; intermediate < num_channel; intermediate++) {
-        for (size_t src = 0; src < num_channel; src++) {
-            for (size_t dst = 0; dst < num_channel; dst++) {
-                if (get_solution_distance(src, intermediate) + get_solution_distance(intermediate, dst) < get_solution_distance(src, dst)) {
-                    set_solution_distance(src, dst, get_solution_distance(src, intermediate) + get_solution_distance(intermediate, dst));
-                }
-            }
-        }
-    }
-}
-
 void print_graph()
 {
     printf("GRAPH\n");
@@ -85,76 +179,254 @@ void print_solution()
 
 bool create_topology(const char* filename)
 {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        printf("Could not open topology file: %s\n", filename);
+    if (!topology_load_csr(&links, filename)) {
         return false;
     }
-    int num_scanned = fscanf(file, "%zu", &num_channel);
-    assert(num_scanned == 1);
-    assert(num_channel > 0);
-    topology = malloc(sizeof(distance_t) * num_channel * num_channel);
-    assert(topology != NULL);
-    solution = malloc(sizeof(distance_t) * num_channel * num_channel);
-    assert(solution != NULL);
-    // populate topology
-    for (size_t src = 0; src < num_channel; src++) {
-        for (size_t dst = 0; dst < num_channel; dst++) {
-            distance_t distance;
-            num_scanned = fscanf(file, "%d", (int*)&distance);
-            assert(num_scanned == 1);
-            // negative values get converted to inf_distance
-            if (distance > inf_distance) {
-                distance = inf_distance;
-            }
-            set_link_distance(src, dst, distance);
-        }
-    }
-    fclose(file);
-    // calculate solution using Floyd-Warshall algorithm
-    floyd_warshall();
+    num_channel = links.n;
+    // map the cached solution, or calculate it using Floyd-Warshall algorithm (and cache it)
+    bool solved = solution_cache_load(&reference, &links, solution_cache_dir());
+    assert(solved);
+    solution = reference.distances;
     return true;
 }
 
 void destroy_topology()
 {
-    free(topology);
-    free(solution);
+    topology_csr_free(&links);
+    solution_free(&reference);
 }
 
-void* router(void* arg)
+// Returns true if the router broadcasts over link e (not its self link and not a failed link)
+bool is_broadcast_link(size_t index, size_t e)
 {
-    bool changed = false;
-    size_t index = (size_t)arg;
-    size_t selected_index;
-    distance_vector_t* prev_prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_prev_state != NULL);
-    distance_vector_t* prev_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(prev_state != NULL);
-    distance_vector_t* curr_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(curr_state != NULL);
-    distance_vector_t* next_state = malloc(sizeof(distance_vector_t) + sizeof(distance_t) * num_channel);
-    assert(next_state != NULL);
-    prev_prev_state->src = index;
-    prev_state->src = index;
-    curr_state->src = index;
-    next_state->src = index;
-    prev_prev_state->epoch = 0;
-    prev_state->epoch = 1;
-    curr_state->epoch = 2;
-    next_state->epoch = 3;
-    for (size_t i = 0; i < num_channel; i++) {
-        prev_prev_state->dist[i] = get_link_distance(index, i);
-        prev_state->dist[i] = get_link_distance(index, i);
-        curr_state->dist[i] = get_link_distance(index, i);
-        next_state->dist[i] = get_link_distance(index, i);
+    return links.neighbors[e] != index && links.weights[e] != inf_distance;
+}
+
+// Returns the number of routers a router broadcasts to
+size_t count_neighbors(size_t index)
+{
+    size_t count = 0;
+    for (size_t e = links.offsets[index]; e < links.offsets[index + 1]; e++) {
+        if (is_broadcast_link(index, e)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Packs the destinations that improved since the last broadcast into a new update
+distance_update_t* create_update(router_t* router)
+{
+    bool dense = router->dense_pending || router->changed_count * DENSE_UPDATE_RATIO >= num_channel;
+    size_t payload = dense ? sizeof(distance_t) * num_channel : sizeof(distance_delta_t) * router->changed_count;
+    distance_update_t* update = malloc(sizeof(distance_update_t) + payload);
+    assert(update != NULL);
+    update->src = router->index;
+    update->epoch = router->epoch++;
+    atomic_init(&update->refs, router->neighbor_count + 1);
+    if (record_series) {
+        if (router->sample_count == router->sample_capacity) {
+            router->sample_capacity = router->sample_capacity * 2 + 8;
+            router->samples = realloc(router->samples, sizeof(epoch_sample_t) * router->sample_capacity);
+            assert(router->samples != NULL);
+        }
+        epoch_sample_t* sample = &router->samples[router->sample_count++];
+        sample->epoch = update->epoch;
+        sample->time_ns = elapsed_ns();
+        sample->destinations = dense ? num_channel : router->changed_count;
+    }
+    if (dense) {
+        update->dist = (distance_t*)update->deltas;
+        update->delta_count = 0;
+        distance_copy(update->dist, router->dist, num_channel);
+        distance_copy(router->sent, router->dist, num_channel);
+        router->changed_count = 0;
+        router->dense_pending = false;
+        return update;
+    }
+    update->dist = NULL;
+    update->delta_count = router->changed_count;
+    for (size_t d = 0; d < router->changed_count; d++) {
+        size_t dest = router->changed_dests[d];
+        update->deltas[d].dest = (uint32_t)dest;
+        update->deltas[d].dist = router->dist[dest];
+        router->sent[dest] = router->dist[dest];
+    }
+    router->changed_count = 0;
+    return update;
+}
+
+void release_update(distance_update_t* update)
+{
+    if (atomic_fetch_sub(&update->refs, 1) == 1) {
+        free(update);
+    }
+}
+
+// Lowers the distances of the router's live direct links to their weights, listing the destinations
+// that improved
+void load_direct_links(router_t* router)
+{
+    for (size_t e = links.offsets[router->index]; e < links.offsets[router->index + 1]; e++) {
+        size_t dest = links.neighbors[e];
+        if (links.weights[e] < router->dist[dest]) {
+            if (router->dist[dest] == router->sent[dest]) {
+                router->changed_dests[router->changed_count++] = (uint32_t)dest;
+            }
+            router->dist[dest] = links.weights[e];
+        }
     }
-    size_t total_select_count = 2;
+}
+
+void init_router(router_t* router, size_t index)
+{
+    router->index = index;
+    router->neighbor_count = count_neighbors(index);
+    router->changed = false;
+    router->epoch = 0;
+    router->merged = 0;
+    router->noop_merges = 0;
+    router->messages_sent = 0;
+    router->blocked_ns = 0;
+    router->send_stalls = 0;
+    router->samples = NULL;
+    router->sample_count = 0;
+    router->sample_capacity = 0;
+    router->dist = malloc(sizeof(distance_t) * num_channel);
+    assert(router->dist != NULL);
+    router->sent = malloc(sizeof(distance_t) * num_channel);
+    assert(router->sent != NULL);
+    router->changed_dests = malloc(sizeof(uint32_t) * num_channel);
+    assert(router->changed_dests != NULL);
+    router->changed_count = 0;
+    router->dense_pending = false;
     for (size_t i = 0; i < num_channel; i++) {
-        if ((i != index) && get_link_distance(index, i) != inf_distance) {
-            total_select_count++;
+        router->dist[i] = inf_distance;
+        router->sent[i] = inf_distance;
+    }
+    // bootstrap: the first broadcast carries every direct link
+    load_direct_links(router);
+    router->update = create_update(router);
+    router->next_link = links.offsets[index];
+    atomic_init(&router->blocked_on, SIZE_MAX);
+    atomic_init(&router->schedule, ROUTER_IDLE);
+}
+
+void free_router(router_t* router)
+{
+    release_update(router->update);
+    free(router->dist);
+    free(router->sent);
+    free(router->changed_dests);
+    free(router->samples);
+}
+
+// Retires a handled message, reserving the broadcast it caused if the router just changed
+void retire_message(router_t* router, bool was_changed)
+{
+    if (router->changed && !was_changed) {
+        // reserve the broadcast this change will cause
+        atomic_fetch_add(&in_flight, router->neighbor_count);
+    }
+    if (atomic_fetch_sub(&in_flight, 1) == 1) {
+        // last message retired, tell the coordinator the network is quiescent
+        enum channel_status status = channel_send(completed_channel, NULL);
+        assert(status == SUCCESS);
+    }
+}
+
+// Handles a control message injected by the coordinator after an event
+void handle_control(router_t* router, distance_update_t* control)
+{
+    bool was_changed = router->changed;
+    if (control == &reset_message) {
+        // restart from the direct links, as after a cold start
+        for (size_t i = 0; i < num_channel; i++) {
+            router->dist[i] = inf_distance;
+            router->sent[i] = inf_distance;
+        }
+        router->changed_count = 0;
+    }
+    // a cheaper direct link is only known to the router itself
+    load_direct_links(router);
+    // neighbors may have lost or not yet seen what the router knows, so send all of it
+    router->changed = true;
+    router->dense_pending = true;
+    retire_message(router, was_changed);
+}
+
+// Merges a neighbor's update and retires the message
+void merge_update(router_t* router, distance_update_t* update)
+{
+    if (update == &reset_message || update == &resend_message) {
+        handle_control(router, update);
+        return;
+    }
+    distance_t neighbor_dist = get_link_distance(router->index, update->src);
+    assert(neighbor_dist != inf_distance);
+    bool was_changed = router->changed;
+    bool improved = false;
+    if (update->dist != NULL && distance_merge(router->dist, update->dist, neighbor_dist, num_channel)) {
+        router->changed = true;
+        router->dense_pending = true;
+        improved = true;
+    }
+    for (size_t d = 0; d < update->delta_count; d++) {
+        size_t i = update->deltas[d].dest;
+        distance_t new_dist = neighbor_dist + update->deltas[d].dist;
+        if (new_dist < router->dist[i]) {
+            if (router->dist[i] == router->sent[i]) {
+                // first improvement of this destination since the last broadcast
+                router->changed_dests[router->changed_count++] = (uint32_t)i;
+            }
+            router->dist[i] = new_dist;
+            router->changed = true;
+            improved = true;
         }
     }
+    release_update(update);
+    router->merged++;
+    router->noop_merges += !improved;
+    retire_message(router, was_changed);
+}
+
+// Starts the next broadcast once the current one reached every neighbor
+// Returns false if nothing changed since the current broadcast
+bool cycle_update(router_t* router)
+{
+    if (!router->changed) {
+        return false;
+    }
+    release_update(router->update);
+    router->update = create_update(router);
+    router->changed = false;
+    return true;
+}
+
+// Fills the send entries of a threaded router's select list with its current broadcast
+// The entries are rebuilt for every broadcast, so they follow the links after every event
+size_t fill_broadcast(router_t* router, select_t* select_list)
+{
+    size_t index = router->index;
+    size_t select_count = 2;
+    for (size_t e = links.offsets[index]; e < links.offsets[index + 1]; e++) {
+        if (is_broadcast_link(index, e)) {
+            select_list[select_count].channel = channels[links.neighbors[e]];
+            select_list[select_count].dir = SEND;
+            select_list[select_count].data = router->update;
+            select_count++;
+        }
+    }
+    return select_count;
+}
+
+void* router(void* arg)
+{
+    router_t* router = &routers[(size_t)arg];
+    size_t index = router->index;
+    size_t selected_index;
+    // only the links of this router are visited, never the whole row
+    size_t total_select_count = 2 + (links.offsets[index + 1] - links.offsets[index]);
     select_t* select_list = malloc(sizeof(select_t) * total_select_count);
     assert(select_list != NULL);
     size_t select_count = 0;
@@ -165,179 +437,602 @@ void* router(void* arg)
     select_list[select_count].channel = channels[index];
     select_list[select_count].dir = RECV;
     select_list[select_count].data = NULL;
-    select_count++;
-    for (size_t i = 0; i < num_channel; i++) {
-        if ((i != index) && get_link_distance(index, i) != inf_distance) {
-            select_list[select_count].channel = channels[i];
-            select_list[select_count].dir = SEND;
-            select_list[select_count].data = curr_state;
-            select_count++;
-        }
-    }
+    select_count = fill_broadcast(router, select_list);
     while (true) {
+        uint64_t before = elapsed_ns();
         enum channel_status status = channel_select(select_list, select_count, &selected_index);
+        router->blocked_ns += elapsed_ns() - before;
         if (status == SUCCESS) {
             assert(selected_index != 0);
             if (selected_index == 1) {
-                if (select_list[selected_index].data) {
-                    // update next_state with new data
-                    distance_vector_t* neighbor_state = select_list[selected_index].data;
-                    distance_t neighbor_dist = get_link_distance(index, neighbor_state->src);
-                    assert(neighbor_dist != inf_distance);
-                    for (size_t i = 0; i < num_channel; i++) {
-                        distance_t new_dist = neighbor_dist + neighbor_state->dist[i];
-                        if (new_dist < next_state->dist[i]) {
-                            next_state->dist[i] = new_dist;
-                            changed = true;
-                        }
-                    }
-                } else {
-                    // special message sent to test convergence
-                    bool converged = (select_count == 2) && !changed;
-                    status = channel_send(completed_channel, converged ? curr_state : NULL);
-                    assert(status == SUCCESS);
-                }
+                // merge the neighbor's update
+                merge_update(router, select_list[selected_index].data);
             } else {
+                router->messages_sent++;
                 select_count--;
                 // swap last element and selected element
                 channel_t* temp = select_list[select_count].channel;
                 select_list[select_count].channel = select_list[selected_index].channel;
                 select_list[selected_index].channel = temp;
             }
-            // check if we've sent to everyone
-            if (select_count == 2) {
-                // check if we want to reset
-                if (changed) {
-                    // cycle triple buffer
-                    distance_vector_t* temp_state = curr_state;
-                    curr_state = next_state;
-                    next_state = prev_prev_state;
-                    prev_prev_state = prev_state;
-                    prev_state = temp_state;
-                    next_state->epoch = curr_state->epoch + 1;
-                    for (size_t i = 0; i < num_channel; i++) {
-                        next_state->dist[i] = curr_state->dist[i];
-                    }
-                    // reset to broadcast again
-                    select_count = total_select_count;
-                    for (size_t i = 2; i < select_count; i++) {
-                        select_list[i].data = curr_state;
-                    }
-                    changed = false;
-                }
+            // check if we've sent to everyone and want to reset
+            if (select_count == 2 && cycle_update(router)) {
+                // reset to broadcast again
+                select_count = fill_broadcast(router, select_list);
             }
         } else {
             assert(status == CLOSED_ERROR);
             assert(selected_index == 0);
-            assert(changed == false);
+            assert(router->changed == false);
             break;
         }
     }
     free(select_list);
-    free(prev_prev_state);
-    free(prev_state);
-    free(curr_state);
-    free(next_state);
     return NULL;
 }
 
-bool check_done()
+void schedule_router(size_t index)
 {
-    bool valid = true;
-    enum channel_status status;
-    distance_vector_t** completed = malloc(sizeof(distance_vector_t*) * num_channel);
-    assert(completed != NULL);
-    // validate by sending special NULL message to flush channels
+    router_t* router = &routers[index];
+    int state = atomic_load(&router->schedule);
+    while (state == ROUTER_IDLE || state == ROUTER_RUNNING) {
+        int next = (state == ROUTER_IDLE) ? ROUTER_QUEUED : ROUTER_RERUN;
+        if (atomic_compare_exchange_weak(&router->schedule, &state, next)) {
+            if (next == ROUTER_QUEUED) {
+                run_queue_t* run_queue = router->run_queue;
+                pthread_mutex_lock(&run_queue->mutex);
+                run_queue->queue[(run_queue->head + run_queue->count) % num_channel] = index;
+                run_queue->count++;
+                pthread_cond_signal(&run_queue->ready);
+                pthread_mutex_unlock(&run_queue->mutex);
+            }
+            return;
+        }
+    }
+}
+
+// Readiness callback of channels[index] in pooled mode
+void channel_ready(void* channel, enum direction dir, void* arg)
+{
+    (void)channel;
+    size_t index = (size_t)arg;
+    if (dir == RECV) {
+        schedule_router(index);
+        return;
+    }
+    // room to send: only wake the routers that found this channel full
+    for (size_t e = reverse_links.offsets[index]; e < reverse_links.offsets[index + 1]; e++) {
+        size_t sender = reverse_links.neighbors[e];
+        if (atomic_load(&routers[sender].blocked_on) == index) {
+            schedule_router(sender);
+        }
+    }
+}
+
+// Runs a router until it has nothing left to receive and cannot send
+void step_router(router_t* router)
+{
+    size_t index = router->index;
+    size_t last_link = links.offsets[index + 1];
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        void* data;
+        while (channel_non_blocking_receive(channels[index], &data) == SUCCESS) {
+            merge_update(router, data);
+            progress = true;
+        }
+        while (router->next_link < last_link) {
+            size_t target = links.neighbors[router->next_link];
+            if (is_broadcast_link(index, router->next_link)) {
+                enum channel_status status = channel_non_blocking_send(channels[target], router->update);
+                if (status == CHANNEL_FULL) {
+                    // register before retrying, so a receive in between still schedules this router
+                    atomic_store(&router->blocked_on, target);
+                    status = channel_non_blocking_send(channels[target], router->update);
+                    if (status == CHANNEL_FULL) {
+                        router->send_stalls++;
+                        break;
+                    }
+                }
+                assert(status == SUCCESS);
+                router->messages_sent++;
+                atomic_store(&router->blocked_on, SIZE_MAX);
+                progress = true;
+            }
+            router->next_link++;
+        }
+        if (router->next_link == last_link && cycle_update(router)) {
+            router->next_link = links.offsets[index];
+            progress = true;
+        }
+    }
+}
+
+void* pool_worker(void* arg)
+{
+    run_queue_t* run_queue = arg;
+    while (true) {
+        pthread_mutex_lock(&run_queue->mutex);
+        while (run_queue->count == 0 && !run_queue->stop) {
+            pthread_cond_wait(&run_queue->ready, &run_queue->mutex);
+        }
+        if (run_queue->stop) {
+            pthread_mutex_unlock(&run_queue->mutex);
+            break;
+        }
+        router_t* router = &routers[run_queue->queue[run_queue->head]];
+        run_queue->head = (run_queue->head + 1) % num_channel;
+        run_queue->count--;
+        pthread_mutex_unlock(&run_queue->mutex);
+        atomic_store(&router->schedule, ROUTER_RUNNING);
+        while (true) {
+            step_router(router);
+            int state = ROUTER_RUNNING;
+            if (atomic_compare_exchange_strong(&router->schedule, &state, ROUTER_IDLE)) {
+                break;
+            }
+            // an event arrived while stepping
+            atomic_store(&router->schedule, ROUTER_RUNNING);
+        }
+    }
+    return NULL;
+}
+
+// Checks every router's distances against the reference solution
+void check_routers()
+{
+    for (size_t src = 0; src < num_channel; src++) {
+        for (size_t dst = 0; dst < num_channel; dst++) {
+            assert(routers[src].dist[dst] == get_solution_distance(src, dst));
+        }
+    }
+}
+
+// Changes the weight of the link u <-> v in both directions and updates the reference solution
+// Rows that changed are flagged in touched, routers whose distances got worse in reset
+// (distance vectors only ever improve, so those have to start over)
+void change_link(size_t u, size_t v, distance_t weight, bool* touched, bool* reset)
+{
+    size_t ends[2][2] = {{u, v}, {v, u}};
+    distance_t old_weights[2];
+    for (size_t d = 0; d < 2; d++) {
+        distance_t* link = topology_csr_find(&links, ends[d][0], ends[d][1]);
+        assert(link != NULL);
+        old_weights[d] = *link;
+        *link = weight;
+    }
+    bool* rows = malloc(sizeof(bool) * num_channel);
+    assert(rows != NULL);
+    for (size_t d = 0; d < 2; d++) {
+        apsp_update_link(solution, &links, ends[d][0], ends[d][1], old_weights[d], rows);
+        for (size_t i = 0; i < num_channel; i++) {
+            touched[i] = touched[i] || rows[i];
+            reset[i] = reset[i] || (rows[i] && weight > old_weights[d]);
+        }
+    }
+    free(rows);
+    routers[u].neighbor_count = count_neighbors(u);
+    routers[v].neighbor_count = count_neighbors(v);
+}
+
+size_t count_merged()
+{
+    size_t merged = 0;
     for (size_t i = 0; i < num_channel; i++) {
-        status = channel_send(channels[i], NULL);
-        assert(status == SUCCESS);
+        merged += routers[i].merged;
+    }
+    return merged;
+}
+
+// Returns NULL if the event fits the loaded topology, otherwise why it doesn't
+const char* check_event(const stress_event_t* event)
+{
+    if (event->src >= num_channel || event->dst >= num_channel) {
+        return "router out of range";
+    }
+    if (event->type == STRESS_NODE_RESTART) {
+        return NULL;
+    }
+    if (event->src == event->dst) {
+        return "a link needs two different routers";
     }
-    // receive special response
+    if (topology_csr_find(&links, event->src, event->dst) == NULL || topology_csr_find(&links, event->dst, event->src) == NULL) {
+        return "no such link in the topology";
+    }
+    return NULL;
+}
+
+// Injects an event into the quiescent network and waits until it is quiescent again
+void inject_event(const stress_event_t* event, stress_event_result_t* result)
+{
+    assert(event->src < num_channel && event->dst < num_channel);
+    bool* touched = calloc(num_channel, sizeof(bool));
+    bool* reset = calloc(num_channel, sizeof(bool));
+    bool* resend = calloc(num_channel, sizeof(bool));
+    assert(touched != NULL && reset != NULL && resend != NULL);
+    if (event->type == STRESS_NODE_RESTART) {
+        reset[event->src] = true;
+    } else {
+        assert(event->src != event->dst);
+        distance_t weight = (event->type == STRESS_LINK_FAILURE) ? inf_distance : event->weight;
+        change_link(event->src, event->dst, weight, touched, reset);
+        resend[event->src] = true;
+        resend[event->dst] = true;
+    }
+    // routers that start over relearn everything from the routers that broadcast to them
     for (size_t i = 0; i < num_channel; i++) {
-        void* data = NULL;
-        status = channel_receive(completed_channel, &data);
-        assert(status == SUCCESS);
-        if (data == NULL) {
-            valid = false;
-        } else {
-            distance_vector_t* new_data = (distance_vector_t*)data;
-            size_t index = new_data->src;
-            completed[index] = new_data;
+        if (reset[i]) {
+            for (size_t e = reverse_links.offsets[i]; e < reverse_links.offsets[i + 1]; e++) {
+                resend[reverse_links.neighbors[e]] = true;
+            }
         }
     }
-    if (valid) {
-        // ensure epoch hasn't changed since first validation
-        for (size_t i = 0; i < num_channel; i++) {
-            status = channel_send(channels[i], NULL);
+    size_t controls = 0;
+    for (size_t i = 0; i < num_channel; i++) {
+        controls += (size_t)reset[i] + (size_t)resend[i];
+        result->changed_rows += (size_t)touched[i];
+    }
+    atomic_fetch_add(&in_flight, controls);
+    size_t merged = count_merged();
+    uint64_t start = elapsed_ns();
+    // every reset is queued before any resend, so no router resets after merging a resent vector
+    for (size_t i = 0; i < num_channel; i++) {
+        if (reset[i]) {
+            enum channel_status status = channel_send(channels[i], &reset_message);
             assert(status == SUCCESS);
         }
-        // receive special response
-        for (size_t i = 0; i < num_channel; i++) {
-            void* data = NULL;
-            status = channel_receive(completed_channel, &data);
+    }
+    for (size_t i = 0; i < num_channel; i++) {
+        if (resend[i]) {
+            enum channel_status status = channel_send(channels[i], &resend_message);
             assert(status == SUCCESS);
-            if (data == NULL) {
-                valid = false;
-            } else {
-                distance_vector_t* new_data = (distance_vector_t*)data;
-                size_t index = new_data->src;
-                if (completed[index]->epoch != new_data->epoch) {
-                    valid = false;
-                }
-            }
         }
-        if (valid) {
-            // check results
-            for (size_t src = 0; src < num_channel; src++) {
-                for (size_t dst = 0; dst < num_channel; dst++) {
-                    assert(completed[src]->dist[dst] == get_solution_distance(src, dst));
-                }
+    }
+    void* data;
+    enum channel_status status = channel_receive(completed_channel, &data);
+    assert(status == SUCCESS);
+    result->reconverge_ms = (double)(elapsed_ns() - start) / 1e6;
+    result->messages = count_merged() - merged;
+    check_routers();
+    free(touched);
+    free(reset);
+    free(resend);
+}
+
+// Adds up the routers' counters
+void summarize_routers(stress_summary_t* summary)
+{
+    summary->routers = num_channel;
+    summary->messages_sent = 0;
+    summary->messages_received = 0;
+    summary->noop_merges = 0;
+    summary->epochs = 0;
+    summary->max_epochs = 0;
+    summary->send_stalls = 0;
+    uint64_t blocked_ns = 0;
+    for (size_t i = 0; i < num_channel; i++) {
+        router_t* router = &routers[i];
+        summary->messages_sent += router->messages_sent;
+        summary->messages_received += router->merged;
+        summary->noop_merges += router->noop_merges;
+        summary->epochs += router->epoch;
+        summary->max_epochs = (router->epoch > summary->max_epochs) ? router->epoch : summary->max_epochs;
+        summary->send_stalls += router->send_stalls;
+        blocked_ns += router->blocked_ns;
+    }
+    summary->blocked_ms = (double)blocked_ns / 1e6;
+}
+
+// Writes one CSV row per epoch: how many routers broadcast it, when the first and the last of them
+// did (microseconds since the run started) and how many destinations they carried in total
+bool write_epoch_series(const char* filename)
+{
+    size_t epochs = 0;
+    for (size_t i = 0; i < num_channel; i++) {
+        epochs = (routers[i].epoch > epochs) ? routers[i].epoch : epochs;
+    }
+    size_t* broadcasts = calloc(epochs, sizeof(size_t));
+    size_t* destinations = calloc(epochs, sizeof(size_t));
+    uint64_t* first = malloc(sizeof(uint64_t) * epochs);
+    uint64_t* last = calloc(epochs, sizeof(uint64_t));
+    FILE* file = fopen(filename, "w");
+    bool valid = file != NULL && (epochs == 0 || (broadcasts != NULL && destinations != NULL && first != NULL && last != NULL));
+    if (valid) {
+        for (size_t e = 0; e < epochs; e++) {
+            first[e] = UINT64_MAX;
+        }
+        for (size_t i = 0; i < num_channel; i++) {
+            for (size_t k = 0; k < routers[i].sample_count; k++) {
+                epoch_sample_t* sample = &routers[i].samples[k];
+                broadcasts[sample->epoch]++;
+                destinations[sample->epoch] += sample->destinations;
+                first[sample->epoch] = (sample->time_ns < first[sample->epoch]) ? sample->time_ns : first[sample->epoch];
+                last[sample->epoch] = (sample->time_ns > last[sample->epoch]) ? sample->time_ns : last[sample->epoch];
             }
         }
+        fprintf(file, "epoch,routers,first_us,last_us,destinations\n");
+        for (size_t e = 0; e < epochs; e++) {
+            fprintf(file, "%zu,%zu,%.3f,%.3f,%zu\n", e, broadcasts[e], (double)first[e] / 1e3, (double)last[e] / 1e3, destinations[e]);
+        }
+    }
+    if (file != NULL) {
+        valid = (fclose(file) == 0) && valid;
     }
-    free(completed);
+    free(broadcasts);
+    free(destinations);
+    free(first);
+    free(last);
     return valid;
 }
 
+void print_stress_summary(const stress_summary_t* summary)
+{
+    printf("SUMMARY\n");
+    printf("routers %zu converged in %.3f ms\n", summary->routers, summary->converge_ms);
+    printf("messages sent %zu received %zu, no-op merges %zu (%.1f%%)\n", summary->messages_sent,
+           summary->messages_received, summary->noop_merges,
+           summary->messages_received == 0 ? 0.0 : 100.0 * (double)summary->noop_merges / (double)summary->messages_received);
+    printf("epochs %zu (at most %zu per router)\n", summary->epochs, summary->max_epochs);
+    printf("blocked in channel_select %.3f ms, send stalls %zu\n", summary->blocked_ms, summary->send_stalls);
+    if (summary->affinity != AFFINITY_NONE) {
+        printf("affinity %s, cpus %s\n", affinity_policy_name(summary->affinity), summary->cpus);
+    } else {
+        printf("placement %s, %zu parts\n", placement_mode_name(summary->placement), summary->parts);
+    }
+}
+
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename)
 {
-    assert(main_buffer_size <= 1); // only support up to a buffer size of 1
-    assert(secondary_buffer_size <= 1); // only support up to a buffer size of 1
+    run_stress_pooled(main_buffer_size, secondary_buffer_size, filename, 0);
+}
+
+void run_stress_pooled(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, size_t workers)
+{
+    run_stress_events(main_buffer_size, secondary_buffer_size, filename, workers, NULL, 0, NULL);
+}
+
+bool run_stress_events(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, size_t workers,
+                       const stress_event_t* events, size_t event_count, stress_event_result_t* results)
+{
+    stress_options_t options;
+    stress_options_init(&options, main_buffer_size, secondary_buffer_size);
+    options.workers = workers;
+    options.events = events;
+    options.event_count = event_count;
+    options.results = results;
+    return run_stress_with(filename, &options);
+}
+
+void stress_options_init(stress_options_t* options, size_t main_buffer_size, size_t secondary_buffer_size)
+{
+    options->main_buffer_size = main_buffer_size;
+    options->secondary_buffer_size = secondary_buffer_size;
+    options->workers = 0;
+    options->placement = PLACEMENT_NONE;
+    options->affinity = affinity_policy_from_env();
+    options->events = NULL;
+    options->event_count = 0;
+    options->results = NULL;
+    options->events_filename = getenv("STRESS_EVENTS");
+    options->summary = NULL;
+    options->report = getenv("STRESS_REPORT") != NULL;
+    options->series_filename = getenv("STRESS_SERIES");
+}
+
+bool run_stress_with(const char* filename, const stress_options_t* options)
+{
+    size_t workers = options->workers;
+    // pooled routers never block, so they can't hand off on unbuffered channels
+    assert(workers == 0 || options->main_buffer_size != 0);
     int pthread_status;
     enum channel_status status;
+    // without events from the caller, the events of the script are injected and reported
+    const stress_event_t* events = options->events;
+    size_t event_count = options->event_count;
+    stress_event_result_t* results = options->results;
+    stress_event_t* script = NULL;
+    if (event_count == 0 && options->events_filename != NULL) {
+        if (!load_stress_events(options->events_filename, &script, &event_count)) {
+            printf("Could not load event script: %s\n", options->events_filename);
+            return false;
+        }
+        events = script;
+        results = malloc(sizeof(stress_event_result_t) * event_count);
+        assert(event_count == 0 || results != NULL);
+    }
     bool initialized = create_topology(filename);
     assert(initialized);
+    // events are checked up front, inject_event only asserts what was checked here
+    for (size_t e = 0; e < event_count; e++) {
+        const char* problem = check_event(&events[e]);
+        if (problem == NULL) {
+            continue;
+        }
+        if (events[e].line != 0) {
+            printf("Invalid event on line %zu: %s\n", events[e].line, problem);
+        } else {
+            printf("Invalid event %zu: %s\n", e, problem);
+        }
+        destroy_topology();
+        if (script != NULL) {
+            free(script);
+            free(results);
+        }
+        return false;
+    }
+    record_series = options->series_filename != NULL;
+    // split the routers into one part per core or NUMA node (at most one per worker), so linked
+    // routers share a part; without placement (or if the CPUs can't be read) there is a single part
+    placement_t placement;
+    bool placed = options->placement != PLACEMENT_NONE && placement_create(&placement, &links, options->placement, workers);
+    size_t parts = placed ? placement.parts : 1;
+    // or pin every thread to a CPU of its own
+    affinity_t affinity;
+    bool pinned = options->placement == PLACEMENT_NONE && options->affinity != AFFINITY_NONE &&
+                  affinity_create(&affinity, options->affinity);
     channels = malloc(sizeof(channel_t*) * num_channel);
     assert(channels != NULL);
-    for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(main_buffer_size);
-        assert(channels[i] != NULL);
+    routers = malloc(sizeof(router_t) * num_channel);
+    assert(routers != NULL);
+    run_queue_count = (workers == 0) ? 0 : parts;
+    run_queues = malloc(sizeof(run_queue_t) * run_queue_count);
+    assert(run_queue_count == 0 || run_queues != NULL);
+    // every router starts with one broadcast to all of its neighbors
+    size_t initial_messages = 0;
+    for (size_t p = 0; p < parts; p++) {
+        if (placed) {
+            // allocate from the part's CPUs, so first touch puts its channels and routers in local memory
+            placement_pin(pthread_self(), &placement, p);
+        }
+        for (size_t i = 0; i < num_channel; i++) {
+            if (placed && placement.part[i] != p) {
+                continue;
+            }
+            channels[i] = channel_create(options->main_buffer_size);
+            assert(channels[i] != NULL);
+            init_router(&routers[i], i);
+            routers[i].run_queue = (workers == 0) ? NULL : &run_queues[p];
+            initial_messages += routers[i].neighbor_count;
+        }
     }
-    done_channel = channel_create(secondary_buffer_size);
+    if (placed) {
+        placement_pin(pthread_self(), &placement, SIZE_MAX);
+    }
+    done_channel = channel_create(options->secondary_buffer_size);
     assert(done_channel != NULL);
-    completed_channel = channel_create(secondary_buffer_size);
+    completed_channel = channel_create(options->secondary_buffer_size);
     assert(completed_channel != NULL);
+    atomic_store(&in_flight, initial_messages);
+
+    // the routers that broadcast to each router, to wake blocked senders and to resend after events
+    bool reversed = topology_csr_transpose(&reverse_links, &links);
+    assert(reversed);
 
-    pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
+    size_t thread_count = (workers == 0) ? num_channel : workers;
+    pthread_t* pid = malloc(sizeof(pthread_t) * thread_count);
     assert(pid != NULL);
+    // the run starts with the first router thread, so the setup above isn't part of converge_ms;
+    // the bootstrap broadcasts init_router queued count as sent at that moment
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
     for (size_t i = 0; i < num_channel; i++) {
-        pthread_status = pthread_create(&pid[i], NULL, router, (void*)i);
-        assert(pthread_status == 0);
+        for (size_t k = 0; k < routers[i].sample_count; k++) {
+            routers[i].samples[k].time_ns = 0;
+        }
+    }
+    if (workers == 0) {
+        // one thread per router
+        for (size_t i = 0; i < num_channel; i++) {
+            pthread_status = pthread_create(&pid[i], NULL, router, (void*)i);
+            assert(pthread_status == 0);
+            if (placed) {
+                placement_pin(pid[i], &placement, placement.part[i]);
+            } else if (pinned) {
+                affinity_pin(pid[i], &affinity, i);
+            }
+        }
+    } else {
+        // routers are run by the pool whenever one of their channels becomes ready
+        for (size_t q = 0; q < run_queue_count; q++) {
+            pthread_mutex_init(&run_queues[q].mutex, NULL);
+            pthread_cond_init(&run_queues[q].ready, NULL);
+            run_queues[q].queue = malloc(sizeof(size_t) * num_channel);
+            assert(run_queues[q].queue != NULL);
+            run_queues[q].head = 0;
+            run_queues[q].count = 0;
+            run_queues[q].stop = false;
+        }
+        for (size_t i = 0; i < num_channel; i++) {
+            status = channel_set_ready_callback(channels[i], channel_ready, (void*)i);
+            assert(status == SUCCESS);
+        }
+        for (size_t i = 0; i < num_channel; i++) {
+            schedule_router(i);
+        }
+        // every part gets at least one worker, since there are no more parts than workers
+        for (size_t i = 0; i < workers; i++) {
+            pthread_status = pthread_create(&pid[i], NULL, pool_worker, &run_queues[i % run_queue_count]);
+            assert(pthread_status == 0);
+            if (placed) {
+                placement_pin(pid[i], &placement, i % run_queue_count);
+            } else if (pinned) {
+                affinity_pin(pid[i], &affinity, i);
+            }
+        }
     }
 
     // wait for convergence
-    while (!check_done()) {
-        usleep(1000);
+    if (initial_messages != 0) {
+        void* data;
+        status = channel_receive(completed_channel, &data);
+        assert(status == SUCCESS);
+    }
+    double converge_ms = (double)elapsed_ns() / 1e6;
+    check_routers();
+
+    // inject the events one at a time, each into a quiescent network
+    for (size_t e = 0; e < event_count; e++) {
+        stress_event_result_t* result = &results[e];
+        result->reconverge_ms = 0;
+        result->messages = 0;
+        result->changed_rows = 0;
+        inject_event(&events[e], result);
     }
 
     // stop threads
     status = channel_close(done_channel);
     assert(status == SUCCESS);
+    for (size_t q = 0; q < run_queue_count; q++) {
+        pthread_mutex_lock(&run_queues[q].mutex);
+        run_queues[q].stop = true;
+        pthread_cond_broadcast(&run_queues[q].ready);
+        pthread_mutex_unlock(&run_queues[q].mutex);
+    }
     // join threads
-    for (size_t i = 0; i < num_channel; i++) {
+    for (size_t i = 0; i < thread_count; i++) {
         pthread_join(pid[i], NULL);
     }
+    // report
+    stress_summary_t summary;
+    summarize_routers(&summary);
+    summary.converge_ms = converge_ms;
+    summary.placement = placed ? options->placement : PLACEMENT_NONE;
+    summary.parts = parts;
+    summary.affinity = pinned ? options->affinity : AFFINITY_NONE;
+    affinity_describe(pinned ? &affinity : NULL, thread_count, summary.cpus);
+    if (options->summary != NULL) {
+        *options->summary = summary;
+    }
+    if (options->report) {
+        print_stress_summary(&summary);
+    }
+    if (options->series_filename != NULL && !write_epoch_series(options->series_filename)) {
+        printf("Could not write epoch series: %s\n", options->series_filename);
+    }
+    if (script != NULL) {
+        print_stress_events(events, results, event_count);
+        free(script);
+        free(results);
+    }
     // cleanup
+    if (workers != 0) {
+        for (size_t i = 0; i < num_channel; i++) {
+            channel_set_ready_callback(channels[i], NULL, NULL);
+        }
+        for (size_t q = 0; q < run_queue_count; q++) {
+            free(run_queues[q].queue);
+            pthread_cond_destroy(&run_queues[q].ready);
+            pthread_mutex_destroy(&run_queues[q].mutex);
+        }
+    }
+    free(run_queues);
+    if (placed) {
+        placement_free(&placement);
+    }
+    if (pinned) {
+        affinity_free(&affinity);
+    }
+    topology_csr_free(&reverse_links);
     status = channel_destroy(done_channel);
     assert(status == SUCCESS);
     status = channel_close(completed_channel);
@@ -349,8 +1044,80 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
         assert(status == SUCCESS);
         status = channel_destroy(channels[i]);
         assert(status == SUCCESS);
+        free_router(&routers[i]);
     }
+    free(routers);
     free(pid);
     free(channels);
     destroy_topology();
+    return true;
+}
+
+bool load_stress_events(const char* filename, stress_event_t** events, size_t* count)
+{
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        return false;
+    }
+    size_t capacity = 16;
+    *events = malloc(sizeof(stress_event_t) * capacity);
+    *count = 0;
+    bool valid = *events != NULL;
+    char line[256];
+    size_t line_number = 0;
+    while (valid && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char kind[16];
+        unsigned long src, dst, weight;
+        int fields = sscanf(line, "%15s %lu %lu %lu", kind, &src, &dst, &weight);
+        if (fields <= 0) {
+            // blank line or comment
+            continue;
+        }
+        stress_event_t event = {.src = src, .dst = dst, .weight = 0, .line = line_number};
+        if (strcmp(kind, "weight") == 0 && fields == 4 && weight < inf_distance) {
+            event.type = STRESS_LINK_WEIGHT;
+            event.weight = (distance_t)weight;
+        } else if (strcmp(kind, "fail") == 0 && fields == 3) {
+            event.type = STRESS_LINK_FAILURE;
+        } else if (strcmp(kind, "restart") == 0 && fields == 2) {
+            event.type = STRESS_NODE_RESTART;
+            event.dst = src;
+        } else {
+            printf("Malformed event on line %zu of %s\n", line_number, filename);
+            valid = false;
+            break;
+        }
+        if (*count == capacity) {
+            capacity *= 2;
+            stress_event_t* grown = realloc(*events, sizeof(stress_event_t) * capacity);
+            if (grown == NULL) {
+                valid = false;
+                break;
+            }
+            *events = grown;
+        }
+        (*events)[(*count)++] = event;
+    }
+    fclose(file);
+    if (!valid) {
+        free(*events);
+        *events = NULL;
+        *count = 0;
+    }
+    return valid;
+}
+
+void print_stress_events(const stress_event_t* events, const stress_event_result_t* results, size_t count)
+{
+    static const char* names[] = {"weight", "fail", "restart"};
+    printf("EVENTS\n");
+    for (size_t e = 0; e < count; e++) {
+        printf("%-7s %5zu %5zu  %10.3f ms  %10zu messages  %6zu rows changed\n", names[events[e].type],
+               events[e].src, events[e].dst, results[e].reconverge_ms, results[e].messages, results[e].changed_rows);
+    }
 }
@@ -1,6 +1,122 @@
 #ifndef STRESS_H
 #define STRESS_H
 
+#include <stddef.h>
+#include <stdbool.h>
+#include "distance.h"
+#include "placement.h"
+
+enum stress_event_type {
+    // the link src <-> dst gets a new weight (a failed link comes back)
+    STRESS_LINK_WEIGHT,
+    // the link src <-> dst fails (its weight becomes inf_distance)
+    STRESS_LINK_FAILURE,
+    // router src loses everything it learned and starts over from its direct links
+    STRESS_NODE_RESTART,
+};
+
+// Both directions of a link change together; the link must be part of the topology file
+typedef struct {
+    enum stress_event_type type;
+    size_t src;
+    size_t dst;
+    distance_t weight;
+    // line of the event script it was read from, 0 if it wasn't read from a script
+    size_t line;
+} stress_event_t;
+
+typedef struct {
+    // from injecting the event until the network is quiescent again
+    double reconverge_ms;
+    // distance-vector updates merged while reconverging
+    size_t messages;
+    // rows of the reference solution the event changed
+    size_t changed_rows;
+} stress_event_result_t;
+
+// Totals of the per-router counters of a run
+typedef struct {
+    size_t routers;
+    // from starting the routers until the network first converged
+    double converge_ms;
+    size_t messages_sent;
+    size_t messages_received;
+    // merges that improved no distance
+    size_t noop_merges;
+    // broadcasts started, in total and by the busiest router
+    size_t epochs;
+    size_t max_epochs;
+    // time spent in channel_select by all router threads (threaded mode)
+    double blocked_ms;
+    // sends that found the channel full and had to wait for a wakeup (pooled mode)
+    size_t send_stalls;
+    // where the threads ran: the placement mode and its parts, or the affinity policy and the CPU
+    // of each router thread (or worker), see affinity_describe
+    enum placement_mode placement;
+    size_t parts;
+    enum affinity_policy affinity;
+    char cpus[AFFINITY_DESCRIPTION];
+} stress_summary_t;
+
+typedef struct {
+    size_t main_buffer_size;
+    size_t secondary_buffer_size;
+    // 0 runs one thread per router, otherwise routers are run by a pool of this many workers
+    size_t workers;
+    // partitions the topology and pins each part's router threads (or workers) to its core or NUMA node
+    enum placement_mode placement;
+    // without placement, pins router thread (or worker) i to one CPU in the policy's order
+    enum affinity_policy affinity;
+    // injected once the network converged, see run_stress_events
+    const stress_event_t* events;
+    size_t event_count;
+    stress_event_result_t* results;
+    // without events, injects the events of this script (see load_stress_events) and prints their results
+    const char* events_filename;
+    // filled with the counters of the run if not NULL
+    stress_summary_t* summary;
+    // prints the summary at the end of the run
+    bool report;
+    // writes the per-epoch time series of the run as CSV if not NULL
+    const char* series_filename;
+} stress_options_t;
+
+// Sets the defaults: one thread per router, no placement and no events
+// The summary is printed if STRESS_REPORT is set, the time series written to STRESS_SERIES if set,
+// the threads pinned with the STRESS_AFFINITY policy if set, and the events of the STRESS_EVENTS
+// script injected if set (e.g. STRESS_EVENTS=events.txt ./channel test_stress 1)
+void stress_options_init(stress_options_t* options, size_t main_buffer_size, size_t secondary_buffer_size);
+
+// Runs the routing stress test on a topology file with the given options
+// Returns false without starting the routers if the event script can't be read or an event doesn't
+// fit the topology (a router out of range, a link from a router to itself or a link that isn't in the file)
+bool run_stress_with(const char* filename, const stress_options_t* options);
+
 void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename);
 
+// Like run_stress, but the routers are state machines run by a pool of worker threads whenever one
+// of their channels becomes ready, instead of one thread each (workers 0 keeps one thread per router)
+void run_stress_pooled(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, size_t workers);
+
+// Like run_stress_pooled, but once the network converged the events are injected one at a time,
+// each after the network reconverged from the previous one; the reference solution is updated
+// incrementally and checked after every event, and results[e] reports event e
+// Returns false without running if an event doesn't fit the topology, see run_stress_with
+bool run_stress_events(size_t main_buffer_size, size_t secondary_buffer_size, const char* filename, size_t workers,
+                       const stress_event_t* events, size_t event_count, stress_event_result_t* results);
+
+// Reads an event script with one event per line ('#' starts a comment):
+//   weight <src> <dst> <weight>
+//   fail <src> <dst>
+//   restart <router>
+// Each event remembers its line, so run_stress_with can report events that don't fit the topology
+// Returns false if the file can't be read or a line is malformed; free the events with free()
+bool load_stress_events(const char* filename, stress_event_t** events, size_t* count);
+
+// Prints the counters of a run
+void print_stress_summary(const stress_summary_t* summary);
+
+// Prints one line per event with its reconvergence time, messages and changed solution rows
+void print_stress_events(const stress_event_t* events, const stress_event_result_t* results, size_t count);
+
 #endif // STRESS_H
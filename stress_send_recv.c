@@ -2,25 +2,106 @@
 #include <pthread.h>
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <stdatomic.h>
+#include <time.h>
 #include "channel.h"
+#include "latency.h"
 #include "stress_send_recv.h"
 
+// Per-worker route and counters, only written by their worker
+typedef struct {
+    // receives from input, or selects over the receives in inputs when there are several
+    // (input is then the first of them)
+    channel_t* input;
+    select_t* inputs;
+    size_t input_count;
+    // forwards to the outputs round-robin, or (if sends is set) to a random output with room,
+    // selecting over sends to all of them while every one is full
+    channel_t** outputs;
+    select_t* sends;
+    size_t output_count;
+    size_t next_output;
+    uint64_t random;
+    size_t hops;
+    latency_histogram_t latency;
+} worker_t;
+
+static const char* pattern_names[] = {
+    [SEND_RECV_RING] = "ring",
+    [SEND_RECV_FAN_IN] = "fan-in",
+    [SEND_RECV_FAN_OUT] = "fan-out",
+    [SEND_RECV_ALL_TO_ALL] = "all-to-all",
+    [SEND_RECV_PIPELINE] = "pipeline",
+};
+
 static size_t num_channel;
 static channel_t** channels;
+static size_t num_workers;
+static worker_t** workers;
 static atomic_bool done;
 static channel_t* main_channel;
+// when each message was last sent, indexed by message
+static uint64_t* msg_stamp;
 
-void* worker_thread(void* arg)
+static uint64_t now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void* worker_receive(worker_t* worker)
 {
-    size_t index = (size_t)arg;
-    size_t next_index = index + 1;
-    if (next_index >= num_channel) {
-        next_index = 0;
+    void* data = NULL;
+    enum channel_status status;
+    if (worker->input_count > 1) {
+        size_t index;
+        status = channel_select(worker->inputs, worker->input_count, &index);
+        data = worker->inputs[index].data;
+    } else {
+        status = channel_receive(worker->input, &data);
     }
-    channel_t* my_channel = channels[index];
-    channel_t* next_channel = channels[next_index];
+    assert(status == SUCCESS);
+    return data;
+}
+
+static void worker_forward(worker_t* worker, void* data)
+{
+    enum channel_status status;
+    if (worker->sends == NULL) {
+        channel_t* next = worker->outputs[worker->next_output];
+        worker->next_output = (worker->next_output + 1 == worker->output_count) ? 0 : worker->next_output + 1;
+        status = channel_send(next, data);
+    } else {
+        // xorshift64
+        worker->random ^= worker->random << 13;
+        worker->random ^= worker->random >> 7;
+        worker->random ^= worker->random << 17;
+        // try every output once starting at a random one, and only block (in select) when all are full
+        size_t first = (size_t)(worker->random % worker->output_count);
+        status = CHANNEL_FULL;
+        for (size_t i = 0; i < worker->output_count && status == CHANNEL_FULL; i++) {
+            size_t next = first + i;
+            next = (next >= worker->output_count) ? next - worker->output_count : next;
+            status = channel_non_blocking_send(worker->outputs[next], data);
+        }
+        if (status == CHANNEL_FULL) {
+            for (size_t i = 0; i < worker->output_count; i++) {
+                worker->sends[i].data = data;
+            }
+            size_t index;
+            status = channel_select(worker->sends, worker->output_count, &index);
+        }
+    }
+    assert(status == SUCCESS);
+}
+
+void* worker_thread(void* arg)
+{
+    worker_t* worker = workers[(size_t)arg];
     bool start = true;
     enum channel_status status;
     while (true) {
@@ -34,69 +115,265 @@ void* worker_thread(void* arg)
                 continue;
             }
         } else {
-            status = channel_receive(my_channel, &data);
-            assert(status == SUCCESS);
+            data = worker_receive(worker);
             if (data == NULL) {
                 // indicates completion
                 break;
             }
         }
+        uint64_t now = now_ns();
+        if (!start) {
+            // the previous worker stamped the message right before sending it
+            latency_record(&worker->latency, now - msg_stamp[(size_t)data]);
+        }
         if (atomic_load(&done)) {
             // Send data to main_channel
             status = channel_send(main_channel, data);
             assert(status == SUCCESS);
         } else {
-            // Pass along message to next thread in ring
-            status = channel_send(next_channel, data);
-            assert(status == SUCCESS);
+            // Pass along message to the next worker of the pattern
+            msg_stamp[(size_t)data] = now;
+            worker_forward(worker, data);
+            worker->hops++;
         }
     }
     return NULL;
 }
 
+const char* send_recv_pattern_name(enum send_recv_pattern pattern)
+{
+    if ((size_t)pattern >= sizeof(pattern_names) / sizeof(pattern_names[0])) {
+        return NULL;
+    }
+    return pattern_names[pattern];
+}
+
+bool send_recv_pattern_parse(const char* name, enum send_recv_pattern* pattern)
+{
+    for (size_t i = 0; i < sizeof(pattern_names) / sizeof(pattern_names[0]); i++) {
+        if (strcmp(name, pattern_names[i]) == 0) {
+            *pattern = (enum send_recv_pattern)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool send_recv_options_valid(const send_recv_options_t* options)
+{
+    if (send_recv_pattern_name(options->pattern) == NULL || affinity_policy_name(options->affinity) == NULL || options->num_threads == 0 ||
+        options->buffer_size == 0 || options->load <= 0 || options->load >= 1) {
+        return false;
+    }
+    switch (options->pattern) {
+    case SEND_RECV_FAN_IN:
+    case SEND_RECV_FAN_OUT:
+    case SEND_RECV_ALL_TO_ALL:
+        return options->num_threads >= 2;
+    case SEND_RECV_PIPELINE:
+        return 1 <= options->stages && options->stages <= options->num_threads;
+    default:
+        return true;
+    }
+}
+
+void send_recv_options_init(send_recv_options_t* options)
+{
+    options->pattern = SEND_RECV_RING;
+    options->buffer_size = 1;
+    options->num_threads = 4;
+    options->stages = 4;
+    options->load = 0.5;
+    options->duration_usec = 1000000;
+    options->affinity = affinity_policy_from_env();
+}
+
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec)
 {
+    send_recv_options_t options;
+    send_recv_options_init(&options);
+    options.buffer_size = buffer_size;
+    options.num_threads = num_threads;
+    options.load = load;
+    options.duration_usec = duration_usec;
+    run_send_recv(&options, NULL);
+}
+
+static channel_t* add_channel(size_t size)
+{
+    channel_t* channel = channel_create(size);
+    assert(channel != NULL);
+    channels[num_channel++] = channel;
+    return channel;
+}
+
+// Routes worker i to receive from input and forward to the output_count channels at outputs
+static void route_worker(size_t i, channel_t* input, channel_t** outputs, size_t output_count)
+{
+    worker_t* worker = workers[i];
+    worker->input = input;
+    worker->input_count = 1;
+    worker->outputs = malloc(sizeof(channel_t*) * output_count);
+    assert(worker->outputs != NULL);
+    memcpy(worker->outputs, outputs, sizeof(channel_t*) * output_count);
+    worker->output_count = output_count;
+}
+
+// Lets worker i select over the receives of the count channels at inputs
+static void route_select(size_t i, channel_t** inputs, size_t count)
+{
+    worker_t* worker = workers[i];
+    worker->inputs = calloc(count, sizeof(select_t));
+    assert(worker->inputs != NULL);
+    for (size_t j = 0; j < count; j++) {
+        worker->inputs[j].channel = inputs[j];
+        worker->inputs[j].dir = RECV;
+    }
+    worker->input = inputs[0];
+    worker->input_count = count;
+}
+
+// Creates the channels of the pattern and routes the workers through them
+// Channels that only return messages to the start of the pattern hold every message, so they never block
+static void build_pattern(const send_recv_options_t* options, size_t num_msgs)
+{
+    size_t buffer_size = options->buffer_size;
+    size_t return_size = (num_msgs > 0) ? num_msgs : 1;
+    // no pattern uses more than a channel per worker
+    channel_t** local = malloc(sizeof(channel_t*) * num_workers);
+    assert(local != NULL);
+    switch (options->pattern) {
+    case SEND_RECV_RING:
+        for (size_t i = 0; i < num_workers; i++) {
+            local[i] = add_channel(buffer_size);
+        }
+        for (size_t i = 0; i < num_workers; i++) {
+            route_worker(i, local[i], &local[(i + 1) % num_workers], 1);
+        }
+        break;
+    case SEND_RECV_FAN_IN: {
+        channel_t* shared = add_channel(buffer_size);
+        for (size_t i = 1; i < num_workers; i++) {
+            local[i] = add_channel(return_size);
+            route_worker(i, local[i], &shared, 1);
+        }
+        route_worker(0, shared, &local[1], num_workers - 1);
+        break;
+    }
+    case SEND_RECV_FAN_OUT: {
+        channel_t* shared = add_channel(buffer_size);
+        for (size_t i = 1; i < num_workers; i++) {
+            local[i] = add_channel(return_size);
+            route_worker(i, shared, &local[i], 1);
+        }
+        route_worker(0, local[1], &shared, 1);
+        if (num_workers > 2) {
+            route_select(0, &local[1], num_workers - 1);
+        }
+        break;
+    }
+    case SEND_RECV_ALL_TO_ALL: {
+        for (size_t i = 0; i < num_workers; i++) {
+            local[i] = add_channel(buffer_size);
+        }
+        channel_t** others = malloc(sizeof(channel_t*) * num_workers);
+        assert(others != NULL);
+        for (size_t i = 0; i < num_workers; i++) {
+            size_t count = 0;
+            for (size_t j = 0; j < num_workers; j++) {
+                if (j != i) {
+                    others[count++] = local[j];
+                }
+            }
+            route_worker(i, local[i], others, count);
+            worker_t* worker = workers[i];
+            worker->sends = calloc(count, sizeof(select_t));
+            assert(worker->sends != NULL);
+            for (size_t j = 0; j < count; j++) {
+                worker->sends[j].channel = others[j];
+                worker->sends[j].dir = SEND;
+            }
+            worker->random = 0x9e3779b97f4a7c15ull * (i + 1);
+        }
+        free(others);
+        break;
+    }
+    case SEND_RECV_PIPELINE:
+        for (size_t s = 0; s < options->stages; s++) {
+            local[s] = add_channel(buffer_size);
+        }
+        for (size_t i = 0; i < num_workers; i++) {
+            size_t stage = i % options->stages;
+            route_worker(i, local[stage], &local[(stage + 1) % options->stages], 1);
+        }
+        break;
+    }
+    free(local);
+}
+
+void run_send_recv(const send_recv_options_t* options, send_recv_result_t* result)
+{
+    assert(send_recv_options_valid(options));
     enum channel_status status;
     // setup
-    num_channel = num_threads;
+    num_workers = options->num_threads;
     atomic_store(&done, false);
-    size_t num_msgs = (size_t)(((double)(num_channel * (buffer_size + 1))) * load);
+    // the buffers of the exercised channels plus a message in every worker's hands
+    size_t capacity = num_workers * (options->buffer_size + 1);
+    if (options->pattern == SEND_RECV_PIPELINE) {
+        capacity = options->stages * options->buffer_size + num_workers;
+    }
+    size_t num_msgs = (size_t)((double)capacity * options->load);
     bool* msg_check = calloc(num_msgs + 1, sizeof(bool));
     assert(msg_check != NULL);
+    msg_stamp = calloc(num_msgs + 1, sizeof(uint64_t));
+    assert(msg_stamp != NULL);
 
-    channels = malloc(sizeof(channel_t*) * num_channel);
+    num_channel = 0;
+    channels = malloc(sizeof(channel_t*) * num_workers);
     assert(channels != NULL);
-    for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(buffer_size);
-        assert(channels[i] != NULL);
+    workers = malloc(sizeof(worker_t*) * num_workers);
+    assert(workers != NULL);
+    for (size_t i = 0; i < num_workers; i++) {
+        // one allocation per worker keeps the counters of different workers apart
+        workers[i] = calloc(1, sizeof(worker_t));
+        assert(workers[i] != NULL);
     }
-    main_channel = channel_create(buffer_size);
+    build_pattern(options, num_msgs);
+    main_channel = channel_create(options->buffer_size);
     assert(main_channel != NULL);
 
-    pthread_t* pid = malloc(sizeof(pthread_t) * num_channel);
+    affinity_t affinity;
+    bool pinned = options->affinity != AFFINITY_NONE && affinity_create(&affinity, options->affinity);
+    pthread_t* pid = malloc(sizeof(pthread_t) * num_workers);
     assert(pid != NULL);
-    for (size_t i = 0; i < num_channel; i++) {
+    for (size_t i = 0; i < num_workers; i++) {
         int pthread_status = pthread_create(&pid[i], NULL, worker_thread, (void*)i);
         assert(pthread_status == 0);
+        if (pinned) {
+            affinity_pin(pid[i], &affinity, i);
+        }
     }
 
     // start test
+    uint64_t start = now_ns();
     for (size_t msg = 1; msg <= num_msgs; msg++) {
         // insert data into threads
         status = channel_send(main_channel, (void*)msg);
         assert(status == SUCCESS);
     }
-    for (size_t i = 0; i < num_channel; i++) {
+    for (size_t i = 0; i < num_workers; i++) {
         // send start message
         status = channel_send(main_channel, NULL);
         assert(status == SUCCESS);
     }
 
     // wait for duration
-    usleep(duration_usec);
+    usleep(options->duration_usec);
 
     // stop test
     atomic_store(&done, true);
+    uint64_t end = now_ns();
     for (size_t msg = 1; msg <= num_msgs; msg++) {
         // pull data from threads
         size_t data = 0;
@@ -109,16 +386,39 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
     }
 
     // shutdown
-    for (size_t i = 0; i < num_channel; i++) {
-        // send stop message
-        status = channel_send(channels[i], NULL);
+    for (size_t i = 0; i < num_workers; i++) {
+        // send stop message (workers sharing an input each take one)
+        status = channel_send(workers[i]->input, NULL);
         assert(status == SUCCESS);
     }
-    for (size_t i = 0; i < num_channel; i++) {
+    for (size_t i = 0; i < num_workers; i++) {
         // join threads
         pthread_join(pid[i], NULL);
     }
 
+    // report
+    if (result != NULL) {
+        latency_histogram_t* latency = calloc(1, sizeof(latency_histogram_t));
+        assert(latency != NULL);
+        result->messages = num_msgs;
+        result->hops = 0;
+        for (size_t i = 0; i < num_workers; i++) {
+            result->hops += workers[i]->hops;
+            latency_merge(latency, &workers[i]->latency);
+        }
+        latency_summary_t summary;
+        latency_summarize(&summary, latency);
+        result->seconds = (double)(end - start) / 1e9;
+        result->hops_per_sec = (double)result->hops / result->seconds;
+        result->p50_ns = summary.p50_ns;
+        result->p90_ns = summary.p90_ns;
+        result->p99_ns = summary.p99_ns;
+        result->p999_ns = summary.p999_ns;
+        result->max_ns = summary.max_ns;
+        affinity_describe(pinned ? &affinity : NULL, num_workers, result->cpus);
+        free(latency);
+    }
+
     // cleanup
     status = channel_close(main_channel);
     assert(status == SUCCESS);
@@ -130,7 +430,35 @@ void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, u
         status = channel_destroy(channels[i]);
         assert(status == SUCCESS);
     }
+    for (size_t i = 0; i < num_workers; i++) {
+        free(workers[i]->inputs);
+        free(workers[i]->outputs);
+        free(workers[i]->sends);
+        free(workers[i]);
+    }
+    if (pinned) {
+        affinity_free(&affinity);
+    }
     free(msg_check);
+    free(msg_stamp);
+    free(workers);
     free(pid);
     free(channels);
 }
+
+void print_send_recv_header(void)
+{
+    printf("pattern,stages,buffer,threads,load,duration_ms,affinity,cpus,messages,hops,hops_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+}
+
+void print_send_recv_result(const send_recv_options_t* options, const send_recv_result_t* result)
+{
+    size_t stages = (options->pattern == SEND_RECV_PIPELINE) ? options->stages : 0;
+    // an affinity that could not be applied leaves cpus empty
+    const char* affinity = (result->cpus[0] != '\0') ? affinity_policy_name(options->affinity) : "none";
+    printf("%s,%zu,%zu,%zu,%.3f,%.3f,%s,%s,%zu,%zu,%.0f,%llu,%llu,%llu,%llu,%llu\n", send_recv_pattern_name(options->pattern),
+           stages, options->buffer_size, options->num_threads, options->load, (double)options->duration_usec / 1e3,
+           affinity, result->cpus, result->messages, result->hops, result->hops_per_sec,
+           (unsigned long long)result->p50_ns, (unsigned long long)result->p90_ns, (unsigned long long)result->p99_ns,
+           (unsigned long long)result->p999_ns, (unsigned long long)result->max_ns);
+}
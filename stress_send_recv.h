@@ -1,6 +1,85 @@
 #ifndef STRESS_SEND_RECV_H
 #define STRESS_SEND_RECV_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "placement.h"
+
+// How the workers pass messages around; messages always circulate, so the load stays constant
+enum send_recv_pattern {
+    // worker i forwards to worker i + 1
+    SEND_RECV_RING,
+    // every worker but the first sends into one shared channel, the first worker receives from it
+    // (and hands the messages back to the others round-robin)
+    SEND_RECV_FAN_IN,
+    // the first worker sends into one shared channel and every other worker receives from it
+    // (and hands the messages back to the first worker, which selects over them)
+    SEND_RECV_FAN_OUT,
+    // every worker forwards to a random other worker, or to any of them with room if that one is full
+    SEND_RECV_ALL_TO_ALL,
+    // the workers are split into stages sharing one input channel each; stage s forwards to s + 1
+    SEND_RECV_PIPELINE,
+};
+
+typedef struct {
+    enum send_recv_pattern pattern;
+    size_t buffer_size;
+    size_t num_threads;
+    // pipeline: number of stages (at most num_threads)
+    size_t stages;
+    // share of the pattern's capacity filled with messages: the buffers of the channels it exercises
+    // plus one message per worker, so num_threads * (buffer_size + 1), or for pipelines
+    // stages * buffer_size + num_threads; no pattern can deadlock below 1
+    double load;
+    useconds_t duration_usec;
+    // pins worker i to one CPU in the policy's order
+    enum affinity_policy affinity;
+} send_recv_options_t;
+
+typedef struct {
+    size_t messages;
+    // messages forwarded from one worker to the next
+    size_t hops;
+    double seconds;
+    double hops_per_sec;
+    // per-hop latency (from a worker sending a message until the next worker received it)
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+    // the CPU of each worker (empty if they were not pinned), see affinity_describe
+    char cpus[AFFINITY_DESCRIPTION];
+} send_recv_result_t;
+
+// Returns the name of a pattern, or NULL for an unknown pattern
+const char* send_recv_pattern_name(enum send_recv_pattern pattern);
+
+// Parses a pattern name ("ring", "fan-in", "fan-out", "all-to-all", "pipeline")
+bool send_recv_pattern_parse(const char* name, enum send_recv_pattern* pattern);
+
+// Returns whether run_send_recv supports the options: 0 < load < 1, two workers or more for
+// fan-in, fan-out and all-to-all, and 1 to num_threads stages for pipelines
+bool send_recv_options_valid(const send_recv_options_t* options);
+
+// Sets the defaults: a ring with buffer size 1, 4 threads (4 pipeline stages), load 0.5 and one second,
+// pinned with the STRESS_AFFINITY policy if set
+void send_recv_options_init(send_recv_options_t* options);
+
+// Runs the benchmark: messages circulate through num_threads workers for the duration, then
+// every message is collected and checked for loss and duplication; result (if not NULL) gets the
+// hop count, throughput and latency percentiles
+void run_send_recv(const send_recv_options_t* options, send_recv_result_t* result);
+
+// Runs a ring with the given parameters and no result
 void run_stress_send_recv(size_t buffer_size, size_t num_threads, double load, useconds_t duration_usec);
 
+// Prints the CSV header matching print_send_recv_result
+void print_send_recv_header(void);
+
+// Prints the options and result of a run as one CSV row
+void print_send_recv_result(const send_recv_options_t* options, const send_recv_result_t* result);
+
 #endif // STRESS_SEND_RECV_H
@@ -10,6 +10,16 @@
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "shared_channel.h"
+#include "journal_channel.h"
+#include "stream_channel.h"
+#include "apsp.h"
+#include "topology.h"
+#include "topology_gen.h"
+#include "solution_cache.h"
+#include "placement.h"
+#include "latency.h"
+#include <sys/wait.h>
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -44,6 +54,14 @@ typedef struct {
     pthread_t pid;
 } cpu_args;
 
+typedef struct {
+    channel_t *channel;
+    void *data[8];
+    size_t min_batch;
+    size_t count;
+    enum channel_status out;
+} batch_args;
+
 int tests_run = 0;
 int tests_passed = 0;
 
@@ -123,6 +141,11 @@ void* helper_non_blocking_receive(receive_args* myargs) {
     return NULL;
 }
 
+void* helper_receive_batch(batch_args *myargs) {
+    myargs->out = channel_receive_batch(myargs->channel, myargs->data, 8, myargs->min_batch, &myargs->count);
+    return NULL;
+}
+
 char* test_initialization() {
     print_test_details(__func__, "Testing the channel intialization");
 
@@ -720,6 +743,9 @@ char* test_response_time() {
     sem_t done;
     sem_init(&done, 0, 0);
     
+    // the average hides the tail, so every response time also goes into a histogram
+    latency_histogram_t* histogram = calloc(1, sizeof(latency_histogram_t));
+    latency_summary_t summary;
     uint64_t total_time = 0;
     for (int i = 0; i < ITERS; i++) {
         receive_args data_rec;
@@ -737,18 +763,22 @@ char* test_response_time() {
         mu_assert("test_response_time: Incorrect message", string_equal(data_rec.data, "Message"));
 
         total_time += t;
+        latency_record(histogram, t);
 
         pthread_join(pid, NULL);
     }
 
     double avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
     mu_assert("test_response_time: Avg response time for send/receive is higher than 0.0005", avg_response_time < 0.0005);
+    latency_summarize(&summary, histogram);
+    latency_print("send to a blocked receive", &summary);
 
     for (size_t i = 0; i < capacity; i++) {
         channel_send(channel, "Message");
     }
 
     total_time = 0;
+    latency_reset(histogram);
     for (int i = 0; i < ITERS; i++) {
         send_args data_send;
         init_object_for_send_api(&data_send, channel, "Message", &done);
@@ -765,13 +795,17 @@ char* test_response_time() {
         mu_assert("test_response_time: Incorrect message", string_equal(data, "Message"));
 
         total_time += t;
+        latency_record(histogram, t);
         pthread_join(pid, NULL);
     }
 
     avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
     mu_assert("test_response_time: Avg response time for send/receive is higher than 0.0005", avg_response_time < 0.0005);
+    latency_summarize(&summary, histogram);
+    latency_print("receive from a blocked send", &summary);
 
     // Free memory
+    free(histogram);
     channel_close(channel);
     channel_destroy(channel);
     sem_destroy(&done);
@@ -868,6 +902,9 @@ char* test_select_response_time() {
     sem_t done;
     sem_init(&done, 0, 0);
 
+    // the average hides the tail, so every response time also goes into a histogram
+    latency_histogram_t* histogram = calloc(1, sizeof(latency_histogram_t));
+    latency_summary_t summary;
     uint64_t total_time = 0;
     for (int i = 0; i < ITERS; i++) {
         // Testing with empty channels and receive API
@@ -888,12 +925,15 @@ char* test_select_response_time() {
         mu_assert("test_select_response_time: Incorrect message", string_equal(args.select_list[2].data, "Message1"));
 
         total_time += t;
+        latency_record(histogram, t);
         // XXX: Code will be stuck here if the select didn't return
         pthread_join(pid, NULL);
     }
 
     double avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
     mu_assert("test_select_response_time: Avg response time for select is higher than 0.0005", avg_response_time < 0.0005);
+    latency_summarize(&summary, histogram);
+    latency_print("send to a blocked select", &summary);
 
     /* This part of code is to test select with multiple receives */
     for (size_t i = 0; i < CHANNELS; i++) {
@@ -903,6 +943,7 @@ char* test_select_response_time() {
     }
 
     total_time = 0;
+    latency_reset(histogram);
     for (int i = 0; i < ITERS; i++) {
         select_args args_1;
         init_object_for_select_api(&args_1, list, CHANNELS, &done);
@@ -922,17 +963,21 @@ char* test_select_response_time() {
         mu_assert("test_select_response_time: Incorrect message", string_equal(data, (i == 0) ? "Message" : "Message4"));
 
         total_time += t;
+        latency_record(histogram, t);
         // XXX: Code will be stuck here if the select didn't return
         pthread_join(pid_1, NULL);
     }
 
     avg_response_time = convertTimeToSeconds(total_time) / (double)ITERS;
     mu_assert("test_select_response_time: Avg response time for select is higher than 0.0005", avg_response_time < 0.0005);
+    latency_summarize(&summary, histogram);
+    latency_print("receive from a blocked select", &summary);
 
     for (size_t i = 0; i < CHANNELS; i++) {
         channel_close(channel[i]);
         channel_destroy(channel[i]);
     }
+    free(histogram);
     sem_destroy(&done);
     return NULL;
 }
@@ -1633,6 +1678,1244 @@ char* test_select_with_duplicate_channel_size1() {
     return test_select_with_duplicate_channel(1);
 }
 
+char* test_shared_channel() {
+    print_test_details(__func__, "Testing cross-process shared-memory channel");
+
+    /* A forked child opens the channel by name and sends values through a small ring,
+     * so the parent must see them in order after both sides block on the process-shared futexes
+     */
+    size_t MSGS = 1000;
+    char name[64];
+    snprintf(name, sizeof(name), "/channel_test_%d", (int)getpid());
+    // remove any region left behind by an earlier crashed run
+    channel_unlink_shared(name);
+    shared_channel_t* channel = channel_create_shared(name, 4, sizeof(size_t));
+    mu_assert("test_shared_channel: Could not create channel", channel != NULL);
+    mu_assert("test_shared_channel: Duplicate create should fail", channel_create_shared(name, 4, sizeof(size_t)) == NULL);
+
+    size_t value = 0;
+    mu_assert("test_shared_channel: Expected empty channel", channel_non_blocking_receive_shared(channel, &value) == CHANNEL_EMPTY);
+
+    pid_t pid = fork();
+    mu_assert("test_shared_channel: fork failed", pid >= 0);
+    if (pid == 0) {
+        shared_channel_t* child = channel_open_shared(name);
+        int code = (child == NULL) ? 1 : 0;
+        for (size_t i = 1; code == 0 && i <= MSGS; i++) {
+            if (channel_send_shared(child, &i) != SUCCESS) {
+                code = 2;
+            }
+        }
+        if (child != NULL) {
+            channel_destroy_shared(child);
+        }
+        _exit(code);
+    }
+
+    for (size_t i = 1; i <= MSGS; i++) {
+        mu_assert("test_shared_channel: Incorrect status", channel_receive_shared(channel, &value) == SUCCESS);
+        mu_assert("test_shared_channel: Incorrect message", value == i);
+    }
+    int child_status = 0;
+    waitpid(pid, &child_status, 0);
+    mu_assert("test_shared_channel: Child failed", WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0);
+
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_shared_channel: Incorrect status", channel_non_blocking_send_shared(channel, &i) == SUCCESS);
+    }
+    mu_assert("test_shared_channel: Expected full channel", channel_non_blocking_send_shared(channel, &value) == CHANNEL_FULL);
+
+    mu_assert("test_shared_channel: Can't close channel", channel_close_shared(channel) == SUCCESS);
+    mu_assert("test_shared_channel: Double close should fail", channel_close_shared(channel) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Send after close should fail", channel_send_shared(channel, &value) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Receive after close should fail", channel_receive_shared(channel, &value) == CLOSED_ERROR);
+    mu_assert("test_shared_channel: Can't destroy channel", channel_destroy_shared(channel) == SUCCESS);
+    mu_assert("test_shared_channel: Can't unlink channel", channel_unlink_shared(name) == SUCCESS);
+    mu_assert("test_shared_channel: Open after unlink should fail", channel_open_shared(name) == NULL);
+    return NULL;
+}
+
+char* test_journal_channel() {
+    print_test_details(__func__, "Testing persistent journal channel replay after reopen");
+
+    /* Messages are spread over several small segments; the first few are acknowledged,
+     * a few more are received without an ack, and everything unacknowledged must be
+     * replayed in order after the journal is closed and reopened
+     */
+    size_t MSGS = 40;
+    size_t ACKED = 5;
+    size_t UNACKED = 3;
+    char dir[64];
+    char message[32];
+    char expected[32];
+    size_t len = 0;
+    snprintf(dir, sizeof(dir), "/tmp/channel_journal_%d", (int)getpid());
+    channel_remove_journal(dir);
+
+    journal_channel_t* channel = channel_open_journal(dir, 256, 4);
+    mu_assert("test_journal_channel: Could not open journal", channel != NULL);
+    mu_assert("test_journal_channel: Expected empty journal", channel_non_blocking_receive_journal(channel, message, sizeof(message), &len) == CHANNEL_EMPTY);
+    for (size_t i = 0; i < MSGS; i++) {
+        int n = snprintf(message, sizeof(message), "Message %zu", i);
+        mu_assert("test_journal_channel: Incorrect status", channel_send_journal(channel, message, (size_t)n + 1) == SUCCESS);
+    }
+    for (size_t i = 0; i < ACKED + UNACKED; i++) {
+        if (i == ACKED) {
+            mu_assert("test_journal_channel: Can't ack", channel_ack_journal(channel) == SUCCESS);
+        }
+        snprintf(expected, sizeof(expected), "Message %zu", i);
+        mu_assert("test_journal_channel: Incorrect status", channel_receive_journal(channel, message, sizeof(message), &len) == SUCCESS);
+        mu_assert("test_journal_channel: Incorrect message", string_equal(message, expected) && len == strlen(expected) + 1);
+    }
+    mu_assert("test_journal_channel: Too small buffer should fail", channel_receive_journal(channel, message, 4, &len) == GENERIC_ERROR);
+    mu_assert("test_journal_channel: Destroy open journal should fail", channel_destroy_journal(channel) == DESTROY_ERROR);
+    mu_assert("test_journal_channel: Can't close journal", channel_close_journal(channel) == SUCCESS);
+    mu_assert("test_journal_channel: Receive after close should fail", channel_receive_journal(channel, message, sizeof(message), &len) == CLOSED_ERROR);
+    mu_assert("test_journal_channel: Send after close should fail", channel_send_journal(channel, message, 1) == CLOSED_ERROR);
+    mu_assert("test_journal_channel: Can't destroy journal", channel_destroy_journal(channel) == SUCCESS);
+
+    channel = channel_open_journal(dir, 256, 4);
+    mu_assert("test_journal_channel: Could not reopen journal", channel != NULL);
+    for (size_t i = ACKED; i < MSGS; i++) {
+        snprintf(expected, sizeof(expected), "Message %zu", i);
+        mu_assert("test_journal_channel: Incorrect status", channel_receive_journal(channel, message, sizeof(message), &len) == SUCCESS);
+        mu_assert("test_journal_channel: Incorrect replayed message", string_equal(message, expected));
+    }
+    mu_assert("test_journal_channel: Expected empty journal", channel_non_blocking_receive_journal(channel, message, sizeof(message), &len) == CHANNEL_EMPTY);
+    mu_assert("test_journal_channel: Can't ack", channel_ack_journal(channel) == SUCCESS);
+    mu_assert("test_journal_channel: Can't close journal", channel_close_journal(channel) == SUCCESS);
+    mu_assert("test_journal_channel: Can't destroy journal", channel_destroy_journal(channel) == SUCCESS);
+    mu_assert("test_journal_channel: Can't remove journal", channel_remove_journal(dir) == SUCCESS);
+    return NULL;
+}
+
+#define STREAM_FRAMES 2000
+
+// Frame i holds i % 41 bytes, each equal to the low byte of i + offset
+static size_t stream_test_len(size_t i) {
+    return i % 41;
+}
+
+void* helper_stream_writer(stream_channel_t* channel) {
+    unsigned char frame[64];
+    for (size_t i = 0; i < STREAM_FRAMES; i++) {
+        size_t len = stream_test_len(i);
+        for (size_t j = 0; j < len; j++) {
+            frame[j] = (unsigned char)(i + j);
+        }
+        if (channel_write_frame(channel, frame, len) != SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static bool stream_test_check(const unsigned char* frame, size_t len, size_t i) {
+    if (len != stream_test_len(i)) {
+        return false;
+    }
+    for (size_t j = 0; j < len; j++) {
+        if (frame[j] != (unsigned char)(i + j)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+char* test_stream_channel() {
+    print_test_details(__func__, "Testing variable-length frames on a byte-stream channel");
+
+    /* A small ring forces frequent wraparound; the reader alternates between copying
+     * reads and zero-copy peek/consume over the two spans, checking every frame in order
+     */
+    stream_channel_t* channel = channel_create_stream(100);
+    mu_assert("test_stream_channel: Could not create channel", channel != NULL);
+
+    unsigned char frame[64];
+    size_t len = 0;
+    mu_assert("test_stream_channel: Expected empty channel", channel_non_blocking_read_frame(channel, frame, sizeof(frame), &len) == CHANNEL_EMPTY);
+    mu_assert("test_stream_channel: Oversized frame should fail", channel_write_frame(channel, frame, 200) == GENERIC_ERROR);
+
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_stream_writer, channel);
+
+    size_t next = 0;
+    while (next < STREAM_FRAMES) {
+        if (next % 2 == 0) {
+            mu_assert("test_stream_channel: Incorrect status", channel_read_frame(channel, frame, sizeof(frame), &len) == SUCCESS);
+            mu_assert("test_stream_channel: Incorrect frame", stream_test_check(frame, len, next));
+            next++;
+            continue;
+        }
+        struct iovec spans[2];
+        size_t count = 0;
+        size_t consumed = 0;
+        mu_assert("test_stream_channel: Incorrect status", channel_peek_stream(channel, spans, &count) == SUCCESS);
+        mu_assert("test_stream_channel: Incorrect span count", count == 1 || count == 2);
+        for (size_t s = 0; s < count; s++) {
+            size_t offset = 0;
+            while (offset < spans[s].iov_len) {
+                uint32_t header;
+                memcpy(&header, (unsigned char*)spans[s].iov_base + offset, sizeof(header));
+                mu_assert("test_stream_channel: Skip marker inside span", header != STREAM_SKIP);
+                mu_assert("test_stream_channel: Incorrect frame", stream_test_check((unsigned char*)spans[s].iov_base + offset + STREAM_FRAME_HEADER, header, next));
+                offset += stream_frame_size(header);
+                next++;
+            }
+            mu_assert("test_stream_channel: Span does not end on a frame", offset == spans[s].iov_len);
+            consumed += offset;
+        }
+        mu_assert("test_stream_channel: Can't consume", channel_consume_stream(channel, consumed) == SUCCESS);
+    }
+    pthread_join(pid, NULL);
+
+    mu_assert("test_stream_channel: Expected empty channel", channel_non_blocking_read_frame(channel, frame, sizeof(frame), &len) == CHANNEL_EMPTY);
+    mu_assert("test_stream_channel: Over-consume should fail", channel_consume_stream(channel, 4) == GENERIC_ERROR);
+    mu_assert("test_stream_channel: Destroy open channel should fail", channel_destroy_stream(channel) == DESTROY_ERROR);
+    mu_assert("test_stream_channel: Can't close channel", channel_close_stream(channel) == SUCCESS);
+    mu_assert("test_stream_channel: Write after close should fail", channel_write_frame(channel, frame, 1) == CLOSED_ERROR);
+    mu_assert("test_stream_channel: Can't destroy channel", channel_destroy_stream(channel) == SUCCESS);
+    return NULL;
+}
+
+char* test_channel_attr() {
+    print_test_details(__func__, "Testing NUMA and huge-page channel attributes");
+
+    /* Placement is best effort, so every combination must still produce a working channel
+     * regardless of whether the machine has NUMA nodes or reserved huge pages
+     */
+    size_t capacity = BUFFER_HUGE_PAGE_SIZE / sizeof(void*) * 2;
+    int nodes[] = {BUFFER_NUMA_ANY, BUFFER_NUMA_CURRENT, 0};
+    enum buffer_pages pages[] = {BUFFER_PAGES_DEFAULT, BUFFER_PAGES_TRANSPARENT, BUFFER_PAGES_EXPLICIT};
+
+    for (size_t n = 0; n < sizeof(nodes) / sizeof(nodes[0]); n++) {
+        for (size_t p = 0; p < sizeof(pages) / sizeof(pages[0]); p++) {
+            channel_attr_t attr;
+            channel_attr_init(&attr);
+            attr.numa_node = nodes[n];
+            attr.pages = pages[p];
+            channel_t* channel = channel_create_attr(capacity, &attr);
+            mu_assert("test_channel_attr: Could not create channel", channel != NULL);
+            mu_assert("test_channel_attr: Buffer capacity is not as expected", buffer_capacity(channel->buffer) == capacity);
+
+            for (size_t i = 0; i < capacity; i += 4096) {
+                mu_assert("test_channel_attr: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+            }
+            void* data = NULL;
+            for (size_t i = 0; i < capacity; i += 4096) {
+                mu_assert("test_channel_attr: Incorrect status", channel_receive(channel, &data) == SUCCESS);
+                mu_assert("test_channel_attr: Incorrect message", string_equal(data, "Message"));
+            }
+            channel_close(channel);
+            mu_assert("test_channel_attr: Can't destroy channel", channel_destroy(channel) == SUCCESS);
+        }
+    }
+
+    channel_t* channel = channel_create_attr(0, NULL);
+    mu_assert("test_channel_attr: Could not create unbuffered channel", channel != NULL);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_watermarks() {
+    print_test_details(__func__, "Testing watermark flow control and batch receive");
+
+    /* A batch receiver must stay parked until its batch is buffered, and a sender blocked on a
+     * full channel must stay parked until the channel drains to the low watermark
+     */
+    size_t capacity = 8;
+    channel_t* channel = channel_create(capacity);
+    pthread_t pid;
+    void* data = NULL;
+
+    mu_assert("test_watermarks: Low watermark must be below capacity", channel_set_watermarks(channel, capacity, 4) == GENERIC_ERROR);
+    mu_assert("test_watermarks: High watermark must be positive", channel_set_watermarks(channel, 2, 0) == GENERIC_ERROR);
+    mu_assert("test_watermarks: Can't set watermarks", channel_set_watermarks(channel, 2, 4) == SUCCESS);
+
+    batch_args batch;
+    batch.channel = channel;
+    batch.min_batch = 0;
+    batch.count = 0;
+    batch.out = GENERIC_ERROR;
+    pthread_create(&pid, NULL, (void *)helper_receive_batch, &batch);
+    for (size_t i = 0; i < 3; i++) {
+        mu_assert("test_watermarks: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+    }
+    usleep(10000);
+    mu_assert("test_watermarks: Batch receiver woke before its batch was available", batch.out == GENERIC_ERROR);
+    mu_assert("test_watermarks: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_watermarks: Incorrect status", batch.out == SUCCESS);
+    mu_assert("test_watermarks: Incorrect batch size", batch.count == 4);
+    for (size_t i = 0; i < batch.count; i++) {
+        mu_assert("test_watermarks: Incorrect message", string_equal(batch.data[i], "Message"));
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        mu_assert("test_watermarks: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+    }
+    send_args send;
+    init_object_for_send_api(&send, channel, "Last", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    for (size_t i = 0; i < capacity - 3; i++) {
+        mu_assert("test_watermarks: Incorrect status", channel_receive(channel, &data) == SUCCESS);
+    }
+    usleep(10000);
+    mu_assert("test_watermarks: Sender woke above the low watermark", send.out == GENERIC_ERROR);
+    mu_assert("test_watermarks: Incorrect status", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_watermarks: Incorrect status", send.out == SUCCESS);
+
+    batch.min_batch = 8;
+    batch.out = GENERIC_ERROR;
+    mu_assert("test_watermarks: Incorrect status", channel_receive_batch(channel, batch.data, 8, 1, &batch.count) == SUCCESS);
+    mu_assert("test_watermarks: Incorrect batch size", batch.count == 3);
+    mu_assert("test_watermarks: Incorrect message", string_equal(batch.data[2], "Last"));
+    pthread_create(&pid, NULL, (void *)helper_receive_batch, &batch);
+    usleep(10000);
+    channel_close(channel);
+    pthread_join(pid, NULL);
+    mu_assert("test_watermarks: Batch receive after close should fail", batch.out == CLOSED_ERROR);
+    channel_destroy(channel);
+
+    channel = channel_create(0);
+    mu_assert("test_watermarks: Unbuffered channel has no watermarks", channel_set_watermarks(channel, 0, 1) == GENERIC_ERROR);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_apsp() {
+    print_test_details(__func__, "Testing blocked and multithreaded all-pairs shortest path solvers against a naive Floyd-Warshall");
+
+    /* Sizes around the tile size exercise partial tiles on every edge
+     */
+    size_t sizes[] = {1, 7, APSP_BLOCK - 1, APSP_BLOCK, APSP_BLOCK + 1, 2 * APSP_BLOCK + 5};
+    unsigned int seed = 1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        distance_t* topology = malloc(sizeof(distance_t) * n * n);
+        distance_t* expected = malloc(sizeof(distance_t) * n * n);
+        distance_t* solution = malloc(sizeof(distance_t) * n * n);
+        for (size_t i = 0; i < n * n; i++) {
+            topology[i] = (rand_r(&seed) % 5 == 0) ? (distance_t)(rand_r(&seed) % 100 + 1) : inf_distance;
+        }
+        for (size_t i = 0; i < n; i++) {
+            topology[i * n + i] = 0;
+        }
+        memcpy(expected, topology, sizeof(distance_t) * n * n);
+        for (size_t k = 0; k < n; k++) {
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    if (expected[i * n + k] + expected[k * n + j] < expected[i * n + j]) {
+                        expected[i * n + j] = expected[i * n + k] + expected[k * n + j];
+                    }
+                }
+            }
+        }
+        apsp_solve(solution, topology, n);
+        bool same = memcmp(solution, expected, sizeof(distance_t) * n * n) == 0;
+        apsp_solve_threads(solution, topology, n, 4);
+        same = same && memcmp(solution, expected, sizeof(distance_t) * n * n) == 0;
+        free(topology);
+        free(expected);
+        free(solution);
+        mu_assert("test_apsp: Blocked solution differs from naive Floyd-Warshall", same);
+    }
+    return NULL;
+}
+
+char* test_topology_formats() {
+    print_test_details(__func__, "Testing text, binary and CSR topology loaders");
+
+    /* Every format written from a loaded topology must load back to the same matrix,
+     * and the stress test must accept a binary topology file
+     */
+    const char* files[] = {"topology.txt", "random_topology.txt", "big_graph.txt"};
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_topology_%d", (int)getpid());
+    for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        topology_t original;
+        mu_assert("test_topology_formats: Could not load text topology", topology_load(&original, files[f]));
+        for (int format = 0; format < 3; format++) {
+            bool saved;
+            if (format == 2) {
+                saved = topology_save_text(&original, path);
+            } else {
+                saved = topology_save_binary(&original, path, (enum topology_format)format);
+            }
+            mu_assert("test_topology_formats: Could not save topology", saved);
+            topology_t copy;
+            mu_assert("test_topology_formats: Could not reload topology", topology_load(&copy, path));
+            bool same = copy.n == original.n && memcmp(copy.links, original.links, sizeof(distance_t) * copy.n * copy.n) == 0;
+            mu_assert("test_topology_formats: Dense binary topology should be mapped in place", format != TOPOLOGY_DENSE || copy.mapping != NULL);
+            topology_free(&copy);
+            mu_assert("test_topology_formats: Reloaded topology differs", same);
+            // the sparse loader must describe the same links
+            topology_csr_t csr;
+            mu_assert("test_topology_formats: Could not load CSR topology", topology_load_csr(&csr, path));
+            distance_t* dense = malloc(sizeof(distance_t) * csr.n * csr.n);
+            topology_csr_to_dense(&csr, dense);
+            same = csr.n == original.n && memcmp(dense, original.links, sizeof(distance_t) * csr.n * csr.n) == 0;
+            for (size_t src = 0; same && src < csr.n; src++) {
+                for (size_t dst = 0; same && dst < csr.n; dst++) {
+                    same = topology_csr_weight(&csr, src, dst) == original.links[src * csr.n + dst];
+                }
+            }
+            free(dense);
+            topology_csr_free(&csr);
+            mu_assert("test_topology_formats: CSR topology differs", same);
+        }
+        topology_free(&original);
+    }
+    topology_t topology;
+    topology_load(&topology, "topology.txt");
+    topology_save_binary(&topology, path, TOPOLOGY_CSR);
+    topology_free(&topology);
+    run_stress(1, 1, path);
+
+    // a CSR row with unsorted or duplicate neighbors would break the binary search, so it must be rejected
+    FILE* file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    size_t size = (size_t)ftell(file);
+    rewind(file);
+    unsigned char* data = malloc(size);
+    mu_assert("test_topology_formats: Could not read CSR topology", fread(data, 1, size, file) == size);
+    fclose(file);
+    topology_header_t header;
+    memcpy(&header, data, sizeof(header));
+    uint64_t* offsets = (uint64_t*)(data + sizeof(header));
+    uint32_t* neighbors = (uint32_t*)(offsets + header.n + 1);
+    size_t row = 0;
+    while (row < header.n && offsets[row + 1] - offsets[row] < 2) {
+        row++;
+    }
+    mu_assert("test_topology_formats: No CSR row with two links", row < header.n);
+    uint32_t* first = &neighbors[offsets[row]];
+    uint32_t sorted[2] = {first[0], first[1]};
+    for (int malformed = 0; malformed < 2; malformed++) {
+        // swap the first two neighbors, then repeat the second one
+        first[0] = sorted[1];
+        first[1] = sorted[malformed == 0 ? 0 : 1];
+        file = fopen(path, "wb");
+        fwrite(data, 1, size, file);
+        fclose(file);
+        topology_csr_t csr;
+        mu_assert("test_topology_formats: Malformed CSR row was accepted", !topology_load_csr(&csr, path));
+    }
+    free(data);
+    unlink(path);
+    return NULL;
+}
+
+typedef struct {
+    size_t readable;
+    size_t writable;
+} ready_counts_t;
+
+void count_ready(void* channel, enum direction dir, void* arg) {
+    (void)channel;
+    ready_counts_t* counts = arg;
+    if (dir == RECV) {
+        counts->readable++;
+    } else {
+        counts->writable++;
+    }
+}
+
+char* test_stress_pooled() {
+    print_test_details(__func__, "Testing readiness callbacks and routers multiplexed on a worker pool");
+
+    /* Every add reports RECV readiness, every removal SEND readiness and close both
+     */
+    ready_counts_t counts = {0, 0};
+    channel_t* channel = channel_create(2);
+    mu_assert("test_stress_pooled: Could not set callback", channel_set_ready_callback(channel, count_ready, &counts) == SUCCESS);
+    channel_non_blocking_send(channel, "a");
+    channel_send(channel, "b");
+    mu_assert("test_stress_pooled: Adds should report RECV readiness", counts.readable == 2 && counts.writable == 0);
+    void* data;
+    channel_non_blocking_receive(channel, &data);
+    channel_receive(channel, &data);
+    mu_assert("test_stress_pooled: Removals should report SEND readiness", counts.readable == 2 && counts.writable == 2);
+    mu_assert("test_stress_pooled: An empty receive should not report anything",
+              channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY && counts.readable == 2 && counts.writable == 2);
+    channel_send(channel, "c");
+    channel_send(channel, "d");
+    mu_assert("test_stress_pooled: A full send should not report anything",
+              channel_non_blocking_send(channel, "e") == CHANNEL_FULL && counts.readable == 4 && counts.writable == 2);
+    channel_close(channel);
+    mu_assert("test_stress_pooled: Close should report both directions", counts.readable == 5 && counts.writable == 3);
+    channel_destroy(channel);
+
+    /* The pooled routers must converge to the same solution with fewer workers than routers
+     */
+    run_stress_pooled(1, 1, "topology.txt", 1);
+    run_stress_pooled(1, 1, "random_topology.txt", 2);
+    run_stress_pooled(1, 1, "big_graph.txt", 3);
+    return NULL;
+}
+
+char* test_topology_generator() {
+    print_test_details(__func__, "Testing the synthetic topology generator");
+
+    /* Every shape must be reproducible from its seed, undirected with a zero diagonal and weights in range,
+     * and every shape but the random one must be connected
+     */
+    size_t n = 60;
+    for (int shape = TOPOLOGY_RANDOM; shape <= TOPOLOGY_SCALE_FREE; shape++) {
+        topology_gen_params_t params;
+        topology_gen_params_init(&params, (enum topology_shape)shape, n);
+        params.min_weight = 2;
+        params.max_weight = 7;
+        params.seed = 42;
+        topology_csr_t first;
+        topology_csr_t second;
+        mu_assert("test_topology_generator: Could not generate topology", topology_generate(&first, &params));
+        mu_assert("test_topology_generator: Could not generate topology", topology_generate(&second, &params));
+        bool same = first.n == n && first.edges == second.edges &&
+                    memcmp(first.offsets, second.offsets, sizeof(size_t) * (n + 1)) == 0 &&
+                    memcmp(first.neighbors, second.neighbors, sizeof(uint32_t) * first.edges) == 0 &&
+                    memcmp(first.weights, second.weights, sizeof(distance_t) * first.edges) == 0;
+        topology_csr_free(&second);
+        mu_assert("test_topology_generator: Same seed should generate the same topology", same);
+        bool valid = true;
+        for (size_t src = 0; src < n; src++) {
+            valid = valid && topology_csr_weight(&first, src, src) == 0;
+            for (size_t e = first.offsets[src]; e < first.offsets[src + 1]; e++) {
+                size_t dst = first.neighbors[e];
+                valid = valid && (dst == src || (first.weights[e] >= 2 && first.weights[e] <= 7)) &&
+                        topology_csr_weight(&first, dst, src) == first.weights[e];
+            }
+            if (shape == TOPOLOGY_GRID || shape == TOPOLOGY_TORUS) {
+                valid = valid && first.offsets[src + 1] - first.offsets[src] <= 5;
+            }
+        }
+        mu_assert("test_topology_generator: Topology should be undirected with weights in range", valid);
+        if (shape != TOPOLOGY_RANDOM) {
+            distance_t* dense = malloc(sizeof(distance_t) * n * n);
+            topology_csr_to_dense(&first, dense);
+            apsp_solve(dense, dense, n);
+            for (size_t i = 0; i < n * n; i++) {
+                valid = valid && dense[i] != inf_distance;
+            }
+            free(dense);
+            mu_assert("test_topology_generator: Topology should be connected", valid);
+        }
+        topology_csr_free(&first);
+    }
+
+    /* Generated files must drive the stress test
+     */
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_generated_%d", (int)getpid());
+    topology_gen_params_t params;
+    topology_gen_params_init(&params, TOPOLOGY_SCALE_FREE, n);
+    topology_csr_t csr;
+    topology_generate(&csr, &params);
+    mu_assert("test_topology_generator: Could not save CSR topology", topology_csr_save_binary(&csr, path, TOPOLOGY_CSR));
+    run_stress(1, 1, path);
+    topology_csr_free(&csr);
+    topology_gen_params_init(&params, TOPOLOGY_TORUS, n);
+    topology_generate(&csr, &params);
+    mu_assert("test_topology_generator: Could not save text topology", topology_csr_save_text(&csr, path));
+    run_stress_pooled(1, 1, path, 2);
+    topology_csr_free(&csr);
+    unlink(path);
+    return NULL;
+}
+
+char* test_stress_buffered() {
+    print_test_details(__func__, "Stress Testing routers with deep channel buffers");
+
+    /* Updates are reference counted, so queued updates stay valid at any buffer depth
+     */
+    size_t sizes[] = {2, 4, 16, 64};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run_stress(sizes[i], sizes[i], "random_topology.txt");
+        run_stress_pooled(sizes[i], 1, "big_graph.txt", 2);
+    }
+    return NULL;
+}
+
+char* test_distance_kernels() {
+    print_test_details(__func__, "Testing the vectorized merge and copy kernels");
+
+    /* The kernels must match a saturating scalar loop for every length (vector body and tail),
+     * including sums that exceed inf_distance or wrap a distance_t
+     */
+    distance_t values[] = {0, 1, 7, 1000, inf_distance - 1, inf_distance, 0xfffffff0u};
+    distance_t throughs[] = {0, 3, inf_distance - 1, inf_distance};
+    distance_t dst[37];
+    distance_t row[37];
+    distance_t expected[37];
+    unsigned int seed = 7;
+    for (size_t n = 0; n <= 37; n += 3) {
+        for (size_t t = 0; t < sizeof(throughs) / sizeof(throughs[0]); t++) {
+            for (size_t i = 0; i < n; i++) {
+                dst[i] = values[(size_t)rand_r(&seed) % 6];
+                row[i] = values[(size_t)rand_r(&seed) % 7];
+            }
+            bool expected_changed = false;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t sum = (uint64_t)row[i] + throughs[t];
+                distance_t candidate = (throughs[t] >= inf_distance || sum > inf_distance) ? inf_distance : (distance_t)sum;
+                expected[i] = dst[i];
+                if (candidate < dst[i]) {
+                    expected[i] = candidate;
+                    expected_changed = true;
+                }
+            }
+            bool changed = distance_merge(dst, row, throughs[t], n);
+            mu_assert("test_distance_kernels: Merge should report improvements", changed == expected_changed);
+            mu_assert("test_distance_kernels: Merge result differs", memcmp(dst, expected, sizeof(distance_t) * n) == 0);
+            mu_assert("test_distance_kernels: Merging again should change nothing", !distance_merge(dst, row, throughs[t], n));
+        }
+        for (size_t i = 0; i < n; i++) {
+            row[i] = dst[i];
+        }
+        mu_assert("test_distance_kernels: Copying equal vectors should report no change", !distance_copy(dst, row, n));
+        if (n > 0) {
+            row[n - 1] = dst[n - 1] + 1;
+            mu_assert("test_distance_kernels: Copy should report a change", distance_copy(dst, row, n));
+            mu_assert("test_distance_kernels: Copy result differs", memcmp(dst, row, sizeof(distance_t) * n) == 0);
+        }
+    }
+    return NULL;
+}
+
+char* test_stress_events() {
+    print_test_details(__func__, "Stress Testing routers reconverging after topology events");
+
+    /* Incremental solution updates must match solving from scratch after every change
+     */
+    topology_csr_t csr;
+    mu_assert("test_stress_events: Could not load topology", topology_load_csr(&csr, "random_topology.txt"));
+    size_t n = csr.n;
+    distance_t* incremental = malloc(sizeof(distance_t) * n * n);
+    distance_t* expected = malloc(sizeof(distance_t) * n * n);
+    bool* rows = malloc(sizeof(bool) * n);
+    topology_csr_to_dense(&csr, incremental);
+    apsp_solve(incremental, incremental, n);
+    distance_t weights[] = {9, 1, inf_distance, 3, inf_distance, 2};
+    size_t step = 0;
+    for (size_t src = 0; src < n; src++) {
+        for (size_t e = csr.offsets[src]; e < csr.offsets[src + 1]; e++) {
+            size_t dst = csr.neighbors[e];
+            if (dst == src) {
+                continue;
+            }
+            distance_t old_weight = csr.weights[e];
+            csr.weights[e] = weights[step++ % (sizeof(weights) / sizeof(weights[0]))];
+            size_t changed = apsp_update_link(incremental, &csr, src, dst, old_weight, rows);
+            topology_csr_to_dense(&csr, expected);
+            apsp_solve(expected, expected, n);
+            mu_assert("test_stress_events: Incremental solution differs", memcmp(incremental, expected, sizeof(distance_t) * n * n) == 0);
+            size_t flagged = 0;
+            for (size_t i = 0; i < n; i++) {
+                flagged += rows[i];
+            }
+            mu_assert("test_stress_events: Changed rows should be counted", flagged == changed);
+        }
+    }
+    free(incremental);
+    free(expected);
+    free(rows);
+    size_t unlinked = 1;
+    while (unlinked < n && topology_csr_find(&csr, 0, unlinked) != NULL) {
+        unlinked++;
+    }
+    mu_assert("test_stress_events: Router 0 is linked to every router", unlinked < n);
+    topology_csr_free(&csr);
+
+    /* Event scripts are parsed line by line, malformed scripts are rejected
+     */
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_events_%d", (int)getpid());
+    FILE* file = fopen(path, "w");
+    fprintf(file, "# scripted events\nweight 0 1 7\n\nfail 0 1  # link down\nweight 0 1 1\nrestart 4\n");
+    fclose(file);
+    stress_event_t* events;
+    size_t count;
+    mu_assert("test_stress_events: Could not load events", load_stress_events(path, &events, &count));
+    mu_assert("test_stress_events: Wrong number of events", count == 4);
+    mu_assert("test_stress_events: Wrong weight event", events[0].type == STRESS_LINK_WEIGHT && events[0].src == 0 && events[0].dst == 1 && events[0].weight == 7);
+    mu_assert("test_stress_events: Wrong failure event", events[1].type == STRESS_LINK_FAILURE && events[1].src == 0 && events[1].dst == 1);
+    mu_assert("test_stress_events: Wrong restart event", events[3].type == STRESS_NODE_RESTART && events[3].src == 4);
+    free(events);
+    file = fopen(path, "w");
+    fprintf(file, "weight 0 1\n");
+    fclose(file);
+    mu_assert("test_stress_events: Malformed events should be rejected", !load_stress_events(path, &events, &count));
+
+    /* Events that don't fit the topology are rejected before the routers start
+     */
+    const char* invalid[] = {"restart 100000\n", "weight 2 2 5\n", "fail 0 %zu\n"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        file = fopen(path, "w");
+        fprintf(file, "weight 0 1 7\n# the bad event is on line 3\n");
+        fprintf(file, invalid[i], unlinked);
+        fclose(file);
+        mu_assert("test_stress_events: Could not load events", load_stress_events(path, &events, &count));
+        mu_assert("test_stress_events: Wrong event line", count == 2 && events[0].line == 1 && events[1].line == 3);
+        stress_event_result_t ignored[2];
+        mu_assert("test_stress_events: An event that doesn't fit the topology should be rejected",
+                  !run_stress_events(1, 1, "random_topology.txt", 0, events, count, ignored));
+        free(events);
+    }
+
+    /* A script given to the stress test is run after convergence and its results printed
+     */
+    file = fopen(path, "w");
+    fprintf(file, "fail 0 1\nweight 0 1 1\nrestart 4\n");
+    fclose(file);
+    stress_options_t options;
+    stress_options_init(&options, 1, 1);
+    options.events_filename = path;
+    mu_assert("test_stress_events: Could not run the event script", run_stress_with("random_topology.txt", &options));
+    unlink(path);
+    mu_assert("test_stress_events: A missing event script should be rejected", !run_stress_with("random_topology.txt", &options));
+
+    /* Routers must reconverge to the updated solution after every event (checked by the stress test),
+     * threaded and pooled
+     */
+    stress_event_t scripted[] = {{STRESS_LINK_WEIGHT, 0, 1, 9},
+                                 {STRESS_LINK_WEIGHT, 0, 1, 1},
+                                 {STRESS_LINK_FAILURE, 0, 1, 0},
+                                 {STRESS_NODE_RESTART, 4, 4, 0},
+                                 {STRESS_LINK_WEIGHT, 0, 1, 2}};
+    size_t scripted_count = sizeof(scripted) / sizeof(scripted[0]);
+    stress_event_result_t results[5];
+    mu_assert("test_stress_events: Could not run events", run_stress_events(1, 1, "random_topology.txt", 0, scripted, scripted_count, results));
+    for (size_t e = 0; e < scripted_count; e++) {
+        mu_assert("test_stress_events: Reconverging should exchange messages", results[e].messages > 0);
+    }
+    mu_assert("test_stress_events: A restart should not change the solution", results[3].changed_rows == 0);
+    mu_assert("test_stress_events: A failure should change the solution", results[2].changed_rows > 0);
+
+    snprintf(path, sizeof(path), "/tmp/channel_events_torus_%d", (int)getpid());
+    topology_gen_params_t params;
+    topology_gen_params_init(&params, TOPOLOGY_TORUS, 64);
+    topology_generate(&csr, &params);
+    mu_assert("test_stress_events: Could not save topology", topology_csr_save_text(&csr, path));
+    size_t neighbor = csr.neighbors[csr.offsets[0]] == 0 ? csr.neighbors[csr.offsets[0] + 1] : csr.neighbors[csr.offsets[0]];
+    topology_csr_free(&csr);
+    stress_event_t torus[] = {{STRESS_LINK_FAILURE, 0, neighbor, 0},
+                              {STRESS_NODE_RESTART, 10, 10, 0},
+                              {STRESS_LINK_WEIGHT, 0, neighbor, 1}};
+    mu_assert("test_stress_events: Could not run events", run_stress_events(4, 1, path, 2, torus, 3, results));
+    for (size_t e = 0; e < 3; e++) {
+        mu_assert("test_stress_events: Reconverging should exchange messages", results[e].messages > 0);
+    }
+    unlink(path);
+    return NULL;
+}
+
+char* test_solution_cache() {
+    print_test_details(__func__, "Testing the on-disk cache of reference solutions");
+
+    char dir[64];
+    char path[128];
+    char dense_path[128];
+    snprintf(dir, sizeof(dir), "/tmp/channel_solutions_%d", (int)getpid());
+    snprintf(dense_path, sizeof(dense_path), "%s.topology", dir);
+    topology_csr_t csr;
+    mu_assert("test_solution_cache: Could not load topology", topology_load_csr(&csr, "big_graph.txt"));
+    size_t n = csr.n;
+    distance_t* expected = malloc(sizeof(distance_t) * n * n);
+    topology_csr_to_dense(&csr, expected);
+    apsp_solve(expected, expected, n);
+    uint64_t key = solution_cache_key(&csr);
+    snprintf(path, sizeof(path), "%s/%016llx.sol", dir, (unsigned long long)key);
+
+    /* The first load solves and stores the solution, the next one maps it
+     */
+    solution_t solution;
+    mu_assert("test_solution_cache: Could not solve", solution_cache_load(&solution, &csr, dir));
+    mu_assert("test_solution_cache: A miss should not be mapped", solution.mapping == NULL);
+    mu_assert("test_solution_cache: Solution differs", memcmp(solution.distances, expected, sizeof(distance_t) * n * n) == 0);
+    solution_free(&solution);
+    mu_assert("test_solution_cache: Could not map", solution_cache_load(&solution, &csr, dir));
+    mu_assert("test_solution_cache: A hit should be mapped", solution.mapping != NULL);
+    mu_assert("test_solution_cache: Cached solution differs", memcmp(solution.distances, expected, sizeof(distance_t) * n * n) == 0);
+    // the mapping is private, so changing the solution must not change the cache
+    solution.distances[1] = 12345;
+    solution_free(&solution);
+    mu_assert("test_solution_cache: Could not map", solution_cache_load(&solution, &csr, dir));
+    mu_assert("test_solution_cache: Cache file was modified", solution.mapping != NULL && solution.distances[1] == expected[1]);
+    solution_free(&solution);
+
+    /* Every format of the same topology shares the key, a different topology doesn't
+     */
+    mu_assert("test_solution_cache: Could not save topology", topology_csr_save_binary(&csr, dense_path, TOPOLOGY_DENSE));
+    topology_csr_t dense;
+    mu_assert("test_solution_cache: Could not load topology", topology_load_csr(&dense, dense_path));
+    mu_assert("test_solution_cache: Formats should share the key", solution_cache_key(&dense) == key);
+    topology_csr_free(&dense);
+    unlink(dense_path);
+    csr.weights[csr.offsets[1]]++;
+    mu_assert("test_solution_cache: Weights should change the key", solution_cache_key(&csr) != key);
+    csr.weights[csr.offsets[1]]--;
+
+    /* A truncated file is a miss and gets replaced, a NULL directory only solves
+     */
+    mu_assert("test_solution_cache: Could not truncate", truncate(path, 40) == 0);
+    mu_assert("test_solution_cache: Could not solve", solution_cache_load(&solution, &csr, dir));
+    mu_assert("test_solution_cache: A truncated file should be a miss", solution.mapping == NULL);
+    solution_free(&solution);
+    mu_assert("test_solution_cache: Could not map", solution_cache_load(&solution, &csr, dir));
+    mu_assert("test_solution_cache: The replaced file should be mapped", solution.mapping != NULL);
+    solution_free(&solution);
+    mu_assert("test_solution_cache: Could not solve", solution_cache_load(&solution, &csr, NULL));
+    mu_assert("test_solution_cache: Uncached solution differs", solution.mapping == NULL && memcmp(solution.distances, expected, sizeof(distance_t) * n * n) == 0);
+    solution_free(&solution);
+
+    /* Stress runs (including events, which update the solution in place) work from the cache
+     */
+    const char* previous = getenv("SOLUTION_CACHE_DIR");
+    setenv("SOLUTION_CACHE_DIR", dir, 1);
+    run_stress(1, 1, "big_graph.txt");
+    stress_event_t events[] = {{STRESS_LINK_FAILURE, 0, csr.neighbors[csr.offsets[0] + 1], 0}};
+    stress_event_result_t results[1];
+    run_stress_events(1, 1, "big_graph.txt", 2, events, 1, results);
+    run_stress(1, 1, "big_graph.txt");
+    if (previous == NULL) {
+        unsetenv("SOLUTION_CACHE_DIR");
+    } else {
+        setenv("SOLUTION_CACHE_DIR", previous, 1);
+    }
+    unlink(path);
+    rmdir(dir);
+    free(expected);
+    topology_csr_free(&csr);
+    return NULL;
+}
+
+char* test_stress_placement() {
+    print_test_details(__func__, "Testing partition-aware placement of routers onto cores");
+
+    cpu_topology_t cpus;
+    mu_assert("test_stress_placement: Could not read the CPUs", cpu_topology_load(&cpus));
+    mu_assert("test_stress_placement: There should be a CPU", cpus.count > 0);
+    for (size_t i = 1; i < cpus.count; i++) {
+        mu_assert("test_stress_placement: CPUs should be sorted", cpus.cpus[i - 1].cpu < cpus.cpus[i].cpu);
+    }
+    cpu_topology_free(&cpus);
+    enum placement_mode mode;
+    mu_assert("test_stress_placement: Could not parse mode", placement_mode_parse("node", &mode) && mode == PLACEMENT_NODE);
+    mu_assert("test_stress_placement: Unknown modes should be rejected", !placement_mode_parse("socket", &mode));
+    mu_assert("test_stress_placement: Wrong mode name", strcmp(placement_mode_name(PLACEMENT_CORE), "core") == 0);
+
+    /* Parts must be balanced and cut far fewer links than spreading routers round-robin
+     */
+    topology_gen_params_t params;
+    topology_gen_params_init(&params, TOPOLOGY_GRID, 1024);
+    topology_csr_t csr;
+    topology_generate(&csr, &params);
+    size_t parts = 8;
+    size_t* part = malloc(sizeof(size_t) * csr.n);
+    size_t sizes[8] = {0};
+    mu_assert("test_stress_placement: Could not partition", placement_partition(part, &csr, parts));
+    for (size_t i = 0; i < csr.n; i++) {
+        mu_assert("test_stress_placement: Invalid part", part[i] < parts);
+        sizes[part[i]]++;
+    }
+    for (size_t p = 0; p < parts; p++) {
+        mu_assert("test_stress_placement: Parts should be balanced", sizes[p] + 8 >= csr.n / parts && sizes[p] <= csr.n / parts + 8);
+    }
+    size_t cut = placement_cut(part, &csr);
+    for (size_t i = 0; i < csr.n; i++) {
+        part[i] = i % parts;
+    }
+    mu_assert("test_stress_placement: Partition should cut few links", cut * 4 < placement_cut(part, &csr));
+    free(part);
+
+    placement_t placement;
+    mu_assert("test_stress_placement: Could not place", placement_create(&placement, &csr, PLACEMENT_CORE, 0));
+    mu_assert("test_stress_placement: There should be a part", placement.parts > 0);
+    for (size_t p = 0; p < placement.parts; p++) {
+        mu_assert("test_stress_placement: Every part needs a CPU", placement.cpu_offsets[p] < placement.cpu_offsets[p + 1]);
+    }
+    for (size_t i = 0; i < csr.n; i++) {
+        mu_assert("test_stress_placement: Invalid placed part", placement.part[i] < placement.parts);
+    }
+    mu_assert("test_stress_placement: Could not pin", placement_pin(pthread_self(), &placement, 0));
+    mu_assert("test_stress_placement: Could not unpin", placement_pin(pthread_self(), &placement, SIZE_MAX));
+    placement_free(&placement);
+    mu_assert("test_stress_placement: Could not place", placement_create(&placement, &csr, PLACEMENT_NODE, 1));
+    mu_assert("test_stress_placement: Parts should be limited", placement.parts == 1);
+    placement_free(&placement);
+    topology_csr_free(&csr);
+
+    /* Placed routers must still converge, threaded and pooled
+     */
+    stress_options_t options;
+    stress_options_init(&options, 1, 1);
+    options.placement = PLACEMENT_CORE;
+    run_stress_with("random_topology.txt", &options);
+    options.placement = PLACEMENT_NODE;
+    options.workers = 3;
+    run_stress_with("big_graph.txt", &options);
+    return NULL;
+}
+
+char* test_stress_summary() {
+    print_test_details(__func__, "Testing the router counters and the epoch time series");
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/channel_series_%d.csv", (int)getpid());
+    for (size_t workers = 0; workers <= 2; workers += 2) {
+        stress_summary_t summary;
+        stress_options_t options;
+        stress_options_init(&options, 1, 1);
+        options.workers = workers;
+        options.summary = &summary;
+        options.report = false;
+        options.series_filename = path;
+        run_stress_with("big_graph.txt", &options);
+        mu_assert("test_stress_summary: Wrong router count", summary.routers == 100);
+        mu_assert("test_stress_summary: Every message sent should be received", summary.messages_sent == summary.messages_received);
+        mu_assert("test_stress_summary: Messages should be counted", summary.messages_sent > 0);
+        mu_assert("test_stress_summary: No-op merges are merges", summary.noop_merges < summary.messages_received);
+        mu_assert("test_stress_summary: Every router broadcasts at least once", summary.epochs >= summary.routers);
+        mu_assert("test_stress_summary: Wrong busiest router", summary.max_epochs >= 1 && summary.max_epochs <= summary.epochs);
+        mu_assert("test_stress_summary: Convergence should be timed", summary.converge_ms > 0);
+        mu_assert("test_stress_summary: Threaded routers should be timed in select", workers != 0 || summary.blocked_ms > 0);
+
+        /* One row per epoch, and every broadcast is listed once
+         */
+        FILE* file = fopen(path, "r");
+        mu_assert("test_stress_summary: Series not written", file != NULL);
+        char line[256];
+        mu_assert("test_stress_summary: Missing header", fgets(line, sizeof(line), file) != NULL &&
+                  strcmp(line, "epoch,routers,first_us,last_us,destinations\n") == 0);
+        size_t rows = 0;
+        size_t broadcasts = 0;
+        size_t epoch, routers, destinations;
+        double first, last;
+        while (fscanf(file, "%zu,%zu,%lf,%lf,%zu", &epoch, &routers, &first, &last, &destinations) == 5) {
+            mu_assert("test_stress_summary: Epochs should be in order", epoch == rows);
+            mu_assert("test_stress_summary: Epoch times out of order", first <= last);
+            rows++;
+            broadcasts += routers;
+        }
+        fclose(file);
+        mu_assert("test_stress_summary: Wrong number of epochs", rows == summary.max_epochs);
+        mu_assert("test_stress_summary: Wrong number of broadcasts", broadcasts == summary.epochs);
+    }
+    unlink(path);
+    return NULL;
+}
+
+char* test_send_recv_bench() {
+    print_test_details(__func__, "Testing the throughput and latency report of the ring benchmark");
+
+    size_t sizes[] = {1, 8};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        send_recv_options_t options;
+        send_recv_options_init(&options);
+        options.buffer_size = sizes[i];
+        options.duration_usec = 200000;
+        send_recv_result_t result;
+        run_send_recv(&options, &result);
+        mu_assert("test_send_recv_bench: Wrong number of messages", result.messages == (size_t)((double)(4 * (sizes[i] + 1)) * 0.5));
+        mu_assert("test_send_recv_bench: Hops should be counted", result.hops > 0);
+        mu_assert("test_send_recv_bench: The run should be timed", result.seconds >= 0.2 && result.hops_per_sec > 0);
+        mu_assert("test_send_recv_bench: Percentiles out of order", 0 < result.p50_ns && result.p50_ns <= result.p99_ns && result.p99_ns <= result.p999_ns);
+        // percentiles are bucket upper bounds, at most ~3% above the largest latency
+        mu_assert("test_send_recv_bench: Percentiles above the maximum", result.p999_ns <= result.max_ns + result.max_ns / 16);
+    }
+    return NULL;
+}
+
+char* test_send_recv_patterns() {
+    print_test_details(__func__, "Testing the fan-in, fan-out, all-to-all and pipeline benchmark patterns");
+
+    enum send_recv_pattern patterns[] = {SEND_RECV_RING, SEND_RECV_FAN_IN, SEND_RECV_FAN_OUT, SEND_RECV_ALL_TO_ALL, SEND_RECV_PIPELINE, SEND_RECV_PIPELINE};
+    size_t threads[] = {4, 4, 4, 4, 4, 5};
+    size_t stages[] = {0, 0, 0, 0, 4, 3};
+    size_t messages[] = {6, 6, 6, 6, 6, 5};
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        enum send_recv_pattern parsed;
+        mu_assert("test_send_recv_patterns: Pattern names should parse back", send_recv_pattern_parse(send_recv_pattern_name(patterns[i]), &parsed) && parsed == patterns[i]);
+        send_recv_options_t options;
+        send_recv_options_init(&options);
+        options.pattern = patterns[i];
+        options.buffer_size = 2;
+        options.num_threads = threads[i];
+        if (stages[i] != 0) {
+            options.stages = stages[i];
+        }
+        options.duration_usec = 100000;
+        mu_assert("test_send_recv_patterns: Options should be valid", send_recv_options_valid(&options));
+        // every message is collected and checked for loss and duplication before the result is filled
+        send_recv_result_t result;
+        run_send_recv(&options, &result);
+        mu_assert("test_send_recv_patterns: Wrong number of messages", result.messages == messages[i]);
+        mu_assert("test_send_recv_patterns: Hops should be counted", result.hops > 0 && result.hops_per_sec > 0);
+        mu_assert("test_send_recv_patterns: Percentiles out of order", 0 < result.p50_ns && result.p50_ns <= result.p99_ns && result.p99_ns <= result.p999_ns);
+    }
+
+    send_recv_options_t options;
+    send_recv_options_init(&options);
+    options.num_threads = 1;
+    mu_assert("test_send_recv_patterns: A ring of one is valid", send_recv_options_valid(&options));
+    options.pattern = SEND_RECV_FAN_IN;
+    mu_assert("test_send_recv_patterns: Fan-in needs two workers", !send_recv_options_valid(&options));
+    options.pattern = SEND_RECV_PIPELINE;
+    mu_assert("test_send_recv_patterns: A pipeline needs a worker per stage", !send_recv_options_valid(&options));
+    options.num_threads = 4;
+    options.load = 1;
+    mu_assert("test_send_recv_patterns: A full load may deadlock", !send_recv_options_valid(&options));
+    mu_assert("test_send_recv_patterns: Unknown patterns should not parse", !send_recv_pattern_parse("star", &options.pattern));
+    return NULL;
+}
+
+char* test_stress_affinity() {
+    print_test_details(__func__, "Testing the compact, scatter, SMT-pairs and cross-socket affinity policies");
+
+    /* Two packages of two cores with two SMT siblings each, numbered like Linux does:
+     * cpu 0-3 are the first siblings of p0c0, p0c1, p1c0, p1c1 and cpu 4-7 the second ones
+     */
+    cpu_info_t machine[8];
+    for (int cpu = 0; cpu < 8; cpu++) {
+        machine[cpu].cpu = cpu;
+        machine[cpu].core = cpu % 2;
+        machine[cpu].package = (cpu / 2) % 2;
+        machine[cpu].node = machine[cpu].package;
+    }
+    cpu_topology_t topology = {8, machine};
+    enum affinity_policy policies[] = {AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_SMT_PAIRS, AFFINITY_CROSS_SOCKET};
+    int expected[][8] = {
+        // siblings, then cores, then packages
+        {0, 4, 1, 5, 2, 6, 3, 7},
+        // a core per thread alternating packages, siblings last
+        {0, 2, 1, 3, 4, 6, 5, 7},
+        // sibling pairs alternating packages
+        {0, 4, 2, 6, 1, 5, 3, 7},
+        // alternating packages, compact within each
+        {0, 2, 4, 6, 1, 3, 5, 7},
+    };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        enum affinity_policy parsed;
+        mu_assert("test_stress_affinity: Policy names should parse back", affinity_policy_parse(affinity_policy_name(policies[p]), &parsed) && parsed == policies[p]);
+        int cpus[8];
+        mu_assert("test_stress_affinity: Could not order", affinity_order(cpus, &topology, policies[p]));
+        mu_assert("test_stress_affinity: Wrong CPU order", memcmp(cpus, expected[p], sizeof(cpus)) == 0);
+    }
+    enum affinity_policy policy;
+    mu_assert("test_stress_affinity: Unknown policies should be rejected", !affinity_policy_parse("numa", &policy));
+
+    /* Threads wrap around the CPUs and the description is truncated
+     */
+    int order[] = {3, 1};
+    affinity_t affinity = {AFFINITY_SCATTER, 2, order};
+    char text[AFFINITY_DESCRIPTION];
+    affinity_describe(&affinity, 3, text);
+    mu_assert("test_stress_affinity: Wrong description", strcmp(text, "3;1;3") == 0);
+    affinity_describe(&affinity, 1000, text);
+    mu_assert("test_stress_affinity: Long descriptions should be truncated", strlen(text) < AFFINITY_DESCRIPTION && strcmp(text + strlen(text) - 3, "...") == 0);
+    affinity_describe(NULL, 3, text);
+    mu_assert("test_stress_affinity: Unpinned threads have no CPUs", text[0] == '\0');
+
+    /* Pinned runs still converge and record where they ran
+     */
+    mu_assert("test_stress_affinity: Could not read the CPUs", affinity_create(&affinity, AFFINITY_SCATTER));
+    char first[16];
+    snprintf(first, sizeof(first), "%d", affinity_cpu(&affinity, 0));
+    affinity_free(&affinity);
+    stress_summary_t summary;
+    stress_options_t options;
+    stress_options_init(&options, 1, 1);
+    options.affinity = AFFINITY_SCATTER;
+    options.workers = 2;
+    options.summary = &summary;
+    run_stress_with("random_topology.txt", &options);
+    mu_assert("test_stress_affinity: Wrong recorded policy", summary.affinity == AFFINITY_SCATTER);
+    mu_assert("test_stress_affinity: Wrong recorded CPUs", strncmp(summary.cpus, first, strlen(first)) == 0 && strchr(summary.cpus, ';') != NULL);
+    options.placement = PLACEMENT_CORE;
+    run_stress_with("random_topology.txt", &options);
+    mu_assert("test_stress_affinity: Placement takes precedence", summary.affinity == AFFINITY_NONE && summary.cpus[0] == '\0');
+
+    send_recv_options_t send_recv;
+    send_recv_options_init(&send_recv);
+    send_recv.affinity = AFFINITY_COMPACT;
+    send_recv.duration_usec = 100000;
+    send_recv_result_t result;
+    run_send_recv(&send_recv, &result);
+    mu_assert("test_stress_affinity: Every worker should be pinned", strchr(result.cpus, '.') == NULL && strlen(result.cpus) >= 7);
+    return NULL;
+}
+
+typedef struct {
+    latency_histogram_t* shared;
+    uint64_t first;
+} latency_args;
+
+void* helper_record_latency(latency_args* args) {
+    for (uint64_t ns = args->first; ns < 100000; ns += 4) {
+        latency_record_atomic(args->shared, ns);
+    }
+    return NULL;
+}
+
+char* test_latency_histogram() {
+    print_test_details(__func__, "Testing the log-bucketed latency histogram");
+
+    latency_histogram_t* histogram = calloc(1, sizeof(latency_histogram_t));
+    latency_summary_t summary;
+    latency_summarize(&summary, histogram);
+    mu_assert("test_latency_histogram: An empty histogram has no percentiles", summary.count == 0 && summary.p99_ns == 0 && summary.max_ns == 0);
+
+    /* 1..100000ns once each: every percentile is within a bucket (about 3%) of the exact one
+     */
+    for (uint64_t ns = 1; ns <= 100000; ns++) {
+        latency_record(histogram, ns);
+    }
+    latency_summarize(&summary, histogram);
+    mu_assert("test_latency_histogram: Wrong count", summary.count == 100000);
+    mu_assert("test_latency_histogram: Wrong mean", summary.mean_ns == 50000);
+    mu_assert("test_latency_histogram: Wrong max", summary.max_ns == 100000);
+    uint64_t exact[] = {50000, 90000, 99000, 99900};
+    uint64_t estimated[] = {summary.p50_ns, summary.p90_ns, summary.p99_ns, summary.p999_ns};
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_latency_histogram: Percentile below the exact one", estimated[i] >= exact[i]);
+        mu_assert("test_latency_histogram: Percentile more than a bucket off", estimated[i] <= exact[i] + exact[i] / 32);
+    }
+    for (uint64_t ns = 0; ns < 64; ns++) {
+        mu_assert("test_latency_histogram: Small latencies should be exact", latency_bucket_max(latency_bucket(ns)) == ns);
+    }
+
+    /* One slow outlier in a thousand moves the tail but hardly the mean
+     */
+    latency_reset(histogram);
+    for (size_t i = 0; i < 999; i++) {
+        latency_record(histogram, 20000);
+    }
+    latency_record(histogram, 50000000);
+    latency_summarize(&summary, histogram);
+    mu_assert("test_latency_histogram: The median should ignore the outlier", summary.p50_ns < 21000 && summary.p99_ns < 21000);
+    mu_assert("test_latency_histogram: p99.9 should show the outlier", summary.p999_ns == 50000000 && summary.max_ns == 50000000);
+
+    /* Threads sharing a histogram, merged into another
+     */
+    latency_reset(histogram);
+    pthread_t pid[4];
+    latency_args args[4];
+    for (size_t i = 0; i < 4; i++) {
+        args[i].shared = histogram;
+        args[i].first = i;
+        pthread_create(&pid[i], NULL, (void *)helper_record_latency, &args[i]);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(pid[i], NULL);
+    }
+    latency_histogram_t* merged = calloc(1, sizeof(latency_histogram_t));
+    latency_record(merged, 1000000);
+    latency_merge(merged, histogram);
+    mu_assert("test_latency_histogram: Lost atomic records", histogram->count == 100000 && histogram->max_ns == 99999);
+    mu_assert("test_latency_histogram: Wrong merged count", merged->count == 100001 && merged->max_ns == 1000000);
+    mu_assert("test_latency_histogram: Wrong merged total", merged->total_ns == 1000000 + 99999ull * 100000 / 2);
+    free(merged);
+    free(histogram);
+    return NULL;
+}
+
+void* helper_stats_sender(channel_t* channel) {
+    for (size_t i = 0; i < 1000; i++) {
+        channel_send(channel, "Message");
+    }
+    return NULL;
+}
+
+char* test_channel_stats() {
+    print_test_details(__func__, "Testing the per-channel statistics counters");
+    channel_t* channel = channel_create(4);
+    channel_stats_t stats;
+
+#ifdef CHANNEL_STATS
+    void* data = NULL;
+    pthread_t pid;
+    mu_assert("test_channel_stats: NULL stats should fail", channel_get_stats(channel, NULL) == GENERIC_ERROR);
+    mu_assert("test_channel_stats: NULL channel should fail", channel_get_stats(NULL, &stats) == GENERIC_ERROR);
+    mu_assert("test_channel_stats: Can't read stats", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_channel_stats: A new channel has no stats", stats.sends == 0 && stats.receives == 0 && stats.blocking_waits == 0 && stats.peak_occupancy == 0);
+
+    // Non-blocking failures on either side
+    mu_assert("test_channel_stats: Incorrect status", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    for (size_t i = 0; i < 4; i++) {
+        mu_assert("test_channel_stats: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+    }
+    mu_assert("test_channel_stats: Incorrect status", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: Wrong non-blocking failures", stats.send_full == 1 && stats.receive_empty == 1);
+    mu_assert("test_channel_stats: Wrong send count", stats.sends == 4 && stats.receives == 0);
+    mu_assert("test_channel_stats: Wrong peak occupancy", stats.peak_occupancy == 4);
+    mu_assert("test_channel_stats: Nothing blocked yet", stats.blocking_waits == 0 && stats.wait_ns == 0 && stats.wakeups == 0);
+
+    // A sender blocked on the full channel is counted once it gets through
+    send_args send;
+    init_object_for_send_api(&send, channel, "Last", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &send);
+    usleep(10000);
+    mu_assert("test_channel_stats: Incorrect status", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_stats: Incorrect status", send.out == SUCCESS);
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: The blocked send wasn't counted", stats.blocking_waits == 1 && stats.wakeups >= 1);
+    mu_assert("test_channel_stats: Spurious wakeups exceed the wakeups", stats.spurious_wakeups < stats.wakeups);
+    mu_assert("test_channel_stats: The blocked send took no time", stats.wait_ns > 0);
+    mu_assert("test_channel_stats: Wrong counts", stats.sends == 5 && stats.receives == 1 && stats.peak_occupancy == 4);
+
+    // A batch receive counts every message it takes
+    size_t count = 0;
+    void* batch[8];
+    mu_assert("test_channel_stats: Incorrect status", channel_receive_batch(channel, batch, 8, 1, &count) == SUCCESS);
+    mu_assert("test_channel_stats: Incorrect batch size", count == 4);
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: Wrong batch receive count", stats.receives == 5);
+
+    // A blocked select is counted on the channel it ends up using
+    select_t list[1];
+    list[0].channel = channel;
+    list[0].dir = RECV;
+    select_args select;
+    init_object_for_select_api(&select, list, 1, NULL);
+    uint64_t waits = stats.blocking_waits;
+    pthread_create(&pid, NULL, (void *)helper_select, &select);
+    usleep(10000);
+    mu_assert("test_channel_stats: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_stats: Incorrect status", select.out == SUCCESS && select.index == 0);
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: The blocked select wasn't counted", stats.blocking_waits == waits + 1);
+    mu_assert("test_channel_stats: Wrong select counts", stats.sends == 6 && stats.receives == 6);
+
+    // No count is lost when many threads share the sharded counters
+    pthread_t senders[4];
+    for (size_t i = 0; i < 4; i++) {
+        pthread_create(&senders[i], NULL, (void *)helper_stats_sender, channel);
+    }
+    for (size_t i = 0; i < 4000; i++) {
+        mu_assert("test_channel_stats: Incorrect status", channel_receive(channel, &data) == SUCCESS);
+    }
+    for (size_t i = 0; i < 4; i++) {
+        pthread_join(senders[i], NULL);
+    }
+    channel_get_stats(channel, &stats);
+    mu_assert("test_channel_stats: Lost concurrent counts", stats.sends == 4006 && stats.receives == 4006);
+    mu_assert("test_channel_stats: Peak occupancy above capacity", stats.peak_occupancy <= 4);
+#else
+    // built with CHANNEL_STATS=0, the counters don't exist
+    mu_assert("test_channel_stats: Statistics should be compiled out", channel_get_stats(channel, &stats) == GENERIC_ERROR);
+#endif
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
 
 typedef char* (*test_fn_t)();
 typedef struct {
@@ -1667,6 +2950,26 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
+                  {"test_shared_channel", test_shared_channel},
+                  {"test_journal_channel", test_journal_channel},
+                  {"test_stream_channel", test_stream_channel},
+                  {"test_channel_attr", test_channel_attr},
+                  {"test_watermarks", test_watermarks},
+                  {"test_apsp", test_apsp},
+                  {"test_topology_formats", test_topology_formats},
+                  {"test_stress_pooled", test_stress_pooled},
+                  {"test_topology_generator", test_topology_generator},
+                  {"test_stress_buffered", test_stress_buffered},
+                  {"test_distance_kernels", test_distance_kernels},
+                  {"test_stress_events", test_stress_events},
+                  {"test_solution_cache", test_solution_cache},
+                  {"test_stress_placement", test_stress_placement},
+                  {"test_stress_summary", test_stress_summary},
+                  {"test_send_recv_bench", test_send_recv_bench},
+                  {"test_send_recv_patterns", test_send_recv_patterns},
+                  {"test_stress_affinity", test_stress_affinity},
+                  {"test_latency_histogram", test_latency_histogram},
+                  {"test_channel_stats", test_channel_stats},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
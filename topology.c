@@ -0,0 +1,591 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "topology.h"
+
+// Maps a whole file privately; writes through the mapping never reach the file
+static void* topology_map(const char* filename, size_t* size)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    void* addr = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+static void topology_init(topology_t* topology)
+{
+    topology->n = 0;
+    topology->links = NULL;
+    topology->mapping = NULL;
+    topology->mapping_size = 0;
+}
+
+static bool topology_alloc(topology_t* topology, size_t n)
+{
+    if (n == 0 || n > (SIZE_MAX / sizeof(distance_t)) / n) {
+        return false;
+    }
+    topology->n = n;
+    topology->links = malloc(sizeof(distance_t) * n * n);
+    topology->mapping = NULL;
+    topology->mapping_size = 0;
+    return topology->links != NULL;
+}
+
+// Reads the next whitespace-separated integer from [*pos, end)
+// Negative values and values above inf_distance are returned as inf_distance
+static bool topology_scan(const char** pos, const char* end, distance_t* value)
+{
+    const char* p = *pos;
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    bool negative = (p < end && *p == '-');
+    p += negative;
+    const char* digits = p;
+    uint64_t v = 0;
+    unsigned int digit;
+    while (p < end && (digit = (unsigned int)(*p - '0')) < 10) {
+        // saturate instead of overflowing; anything this large is clamped below anyway
+        v = (v > inf_distance) ? v : v * 10 + digit;
+        p++;
+    }
+    if (p == digits) {
+        return false;
+    }
+    *pos = p;
+    *value = (negative || v > inf_distance) ? inf_distance : (distance_t)v;
+    return true;
+}
+
+bool topology_load_text(topology_t* topology, const char* filename)
+{
+    topology_init(topology);
+    size_t size = 0;
+    char* text = topology_map(filename, &size);
+    if (text == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    const char* pos = text;
+    const char* end = text + size;
+    distance_t n;
+    bool valid = topology_scan(&pos, end, &n) && n != inf_distance && topology_alloc(topology, n);
+    for (size_t i = 0; valid && i < topology->n * topology->n; i++) {
+        valid = topology_scan(&pos, end, &topology->links[i]);
+    }
+    munmap(text, size);
+    if (!valid) {
+        printf("Malformed topology file: %s\n", filename);
+        topology_free(topology);
+    }
+    return valid;
+}
+
+bool topology_load_binary(topology_t* topology, const char* filename)
+{
+    topology_init(topology);
+    size_t size = 0;
+    unsigned char* data = topology_map(filename, &size);
+    if (data == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    topology_header_t header;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data, sizeof(header));
+        valid = memcmp(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic)) == 0 && header.n > 0 &&
+                header.n <= (SIZE_MAX / sizeof(distance_t)) / header.n;
+    }
+    size_t n = valid ? (size_t)header.n : 0;
+    if (valid && header.format == TOPOLOGY_DENSE) {
+        valid = size == sizeof(header) + sizeof(distance_t) * n * n;
+        if (valid) {
+            // the matrix is used in place, so loading costs one mapping
+            topology->n = n;
+            topology->links = (distance_t*)(data + sizeof(header));
+            topology->mapping = data;
+            topology->mapping_size = size;
+            return true;
+        }
+    } else if (valid && header.format == TOPOLOGY_CSR) {
+        size_t edges = (size_t)header.edges;
+        valid = edges <= n * n &&
+                size == sizeof(header) + sizeof(uint64_t) * (n + 1) + (sizeof(uint32_t) + sizeof(distance_t)) * edges;
+        if (valid && topology_alloc(topology, n)) {
+            const uint64_t* offsets = (const uint64_t*)(data + sizeof(header));
+            const uint32_t* neighbors = (const uint32_t*)(offsets + n + 1);
+            const distance_t* weights = (const distance_t*)(neighbors + edges);
+            for (size_t i = 0; i < n * n; i++) {
+                topology->links[i] = inf_distance;
+            }
+            valid = offsets[0] == 0 && offsets[n] == edges;
+            for (size_t src = 0; valid && src < n; src++) {
+                valid = offsets[src] <= offsets[src + 1] && offsets[src + 1] <= edges;
+                for (size_t e = (size_t)offsets[src]; valid && e < offsets[src + 1]; e++) {
+                    valid = neighbors[e] < n && weights[e] <= inf_distance;
+                    if (valid) {
+                        topology->links[src * n + neighbors[e]] = weights[e];
+                    }
+                }
+            }
+            if (!valid) {
+                topology_free(topology);
+            }
+        } else {
+            valid = false;
+        }
+    } else {
+        valid = false;
+    }
+    munmap(data, size);
+    if (!valid) {
+        printf("Malformed topology file: %s\n", filename);
+    }
+    return valid;
+}
+
+bool topology_load(topology_t* topology, const char* filename)
+{
+    char magic[sizeof(TOPOLOGY_MAGIC)] = {0};
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    if (read == sizeof(magic) && memcmp(magic, TOPOLOGY_MAGIC, sizeof(magic)) == 0) {
+        return topology_load_binary(topology, filename);
+    }
+    return topology_load_text(topology, filename);
+}
+
+bool topology_save_text(const topology_t* topology, const char* filename)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        return false;
+    }
+    fprintf(file, "%zu\n", topology->n);
+    for (size_t src = 0; src < topology->n; src++) {
+        for (size_t dst = 0; dst < topology->n; dst++) {
+            distance_t distance = topology->links[src * topology->n + dst];
+            if (distance == inf_distance) {
+                fprintf(file, " -1");
+            } else {
+                fprintf(file, " %u", distance);
+            }
+        }
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+
+bool topology_save_binary(const topology_t* topology, const char* filename, enum topology_format format)
+{
+    size_t n = topology->n;
+    if (format == TOPOLOGY_CSR && n > UINT32_MAX) {
+        return false;
+    }
+    topology_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic));
+    header.n = n;
+    header.format = format;
+    for (size_t i = 0; i < n * n; i++) {
+        header.edges += (topology->links[i] != inf_distance);
+    }
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool valid = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (format == TOPOLOGY_DENSE) {
+        valid = valid && fwrite(topology->links, sizeof(distance_t), n * n, file) == n * n;
+    } else {
+        size_t edges = (size_t)header.edges;
+        uint64_t* offsets = malloc(sizeof(uint64_t) * (n + 1));
+        uint32_t* neighbors = malloc(sizeof(uint32_t) * edges + 1);
+        distance_t* weights = malloc(sizeof(distance_t) * edges + 1);
+        valid = valid && offsets != NULL && neighbors != NULL && weights != NULL;
+        if (valid) {
+            size_t e = 0;
+            for (size_t src = 0; src < n; src++) {
+                offsets[src] = e;
+                for (size_t dst = 0; dst < n; dst++) {
+                    if (topology->links[src * n + dst] != inf_distance) {
+                        neighbors[e] = (uint32_t)dst;
+                        weights[e] = topology->links[src * n + dst];
+                        e++;
+                    }
+                }
+            }
+            offsets[n] = e;
+            valid = fwrite(offsets, sizeof(uint64_t), n + 1, file) == n + 1 &&
+                    fwrite(neighbors, sizeof(uint32_t), edges, file) == edges &&
+                    fwrite(weights, sizeof(distance_t), edges, file) == edges;
+        }
+        free(offsets);
+        free(neighbors);
+        free(weights);
+    }
+    return (fclose(file) == 0) && valid;
+}
+
+void topology_free(topology_t* topology)
+{
+    if (topology->mapping != NULL) {
+        munmap(topology->mapping, topology->mapping_size);
+    } else {
+        free(topology->links);
+    }
+    topology->links = NULL;
+    topology->mapping = NULL;
+    topology->mapping_size = 0;
+}
+
+static void topology_csr_init(topology_csr_t* csr)
+{
+    csr->n = 0;
+    csr->edges = 0;
+    csr->offsets = NULL;
+    csr->neighbors = NULL;
+    csr->weights = NULL;
+}
+
+static bool topology_csr_alloc(topology_csr_t* csr, size_t n, size_t edges)
+{
+    csr->n = n;
+    csr->edges = 0;
+    csr->offsets = malloc(sizeof(size_t) * (n + 1));
+    csr->neighbors = malloc(sizeof(uint32_t) * (edges + 1));
+    csr->weights = malloc(sizeof(distance_t) * (edges + 1));
+    return csr->offsets != NULL && csr->neighbors != NULL && csr->weights != NULL;
+}
+
+// Appends one link, doubling the edge arrays when they are full
+static bool topology_csr_append(topology_csr_t* csr, size_t* capacity, size_t dst, distance_t weight)
+{
+    if (csr->edges == *capacity) {
+        size_t grown = 2 * *capacity + 1;
+        uint32_t* neighbors = realloc(csr->neighbors, sizeof(uint32_t) * grown);
+        if (neighbors == NULL) {
+            return false;
+        }
+        csr->neighbors = neighbors;
+        distance_t* weights = realloc(csr->weights, sizeof(distance_t) * grown);
+        if (weights == NULL) {
+            return false;
+        }
+        csr->weights = weights;
+        *capacity = grown;
+    }
+    csr->neighbors[csr->edges] = (uint32_t)dst;
+    csr->weights[csr->edges] = weight;
+    csr->edges++;
+    return true;
+}
+
+static bool topology_csr_load_text(topology_csr_t* csr, const char* filename)
+{
+    size_t size = 0;
+    char* text = topology_map(filename, &size);
+    if (text == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    const char* pos = text;
+    const char* end = text + size;
+    distance_t n;
+    size_t capacity = 0;
+    bool valid = topology_scan(&pos, end, &n) && n != inf_distance && n > 0 && topology_csr_alloc(csr, n, 0);
+    for (size_t src = 0; valid && src < csr->n; src++) {
+        csr->offsets[src] = csr->edges;
+        for (size_t dst = 0; valid && dst < csr->n; dst++) {
+            distance_t weight;
+            valid = topology_scan(&pos, end, &weight);
+            if (valid && weight != inf_distance) {
+                valid = topology_csr_append(csr, &capacity, dst, weight);
+            }
+        }
+    }
+    if (valid) {
+        csr->offsets[csr->n] = csr->edges;
+    }
+    munmap(text, size);
+    if (!valid) {
+        printf("Malformed topology file: %s\n", filename);
+    }
+    return valid;
+}
+
+static bool topology_csr_load_binary(topology_csr_t* csr, const char* filename)
+{
+    size_t size = 0;
+    unsigned char* data = topology_map(filename, &size);
+    if (data == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    topology_header_t header;
+    memcpy(&header, data, sizeof(header));
+    size_t n = (size_t)header.n;
+    size_t edges = (size_t)header.edges;
+    bool valid = header.format == TOPOLOGY_CSR && n > 0 && n <= UINT32_MAX && edges <= n * n &&
+                 size == sizeof(header) + sizeof(uint64_t) * (n + 1) + (sizeof(uint32_t) + sizeof(distance_t)) * edges;
+    if (valid && topology_csr_alloc(csr, n, edges)) {
+        const uint64_t* offsets = (const uint64_t*)(data + sizeof(header));
+        const uint32_t* neighbors = (const uint32_t*)(offsets + n + 1);
+        const distance_t* weights = (const distance_t*)(neighbors + edges);
+        valid = offsets[0] == 0 && offsets[n] == edges;
+        for (size_t src = 0; valid && src <= n; src++) {
+            valid = offsets[src] <= edges && (src == 0 || offsets[src - 1] <= offsets[src]);
+            csr->offsets[src] = (size_t)offsets[src];
+        }
+        // rows are binary searched, so their neighbors must be strictly increasing
+        for (size_t src = 0; valid && src < n; src++) {
+            for (size_t e = csr->offsets[src]; valid && e < csr->offsets[src + 1]; e++) {
+                valid = neighbors[e] < n && weights[e] <= inf_distance &&
+                        (e == csr->offsets[src] || neighbors[e - 1] < neighbors[e]);
+            }
+        }
+        if (valid) {
+            memcpy(csr->neighbors, neighbors, sizeof(uint32_t) * edges);
+            memcpy(csr->weights, weights, sizeof(distance_t) * edges);
+            csr->edges = edges;
+        }
+    } else {
+        valid = false;
+    }
+    munmap(data, size);
+    if (!valid) {
+        printf("Malformed topology file: %s\n", filename);
+    }
+    return valid;
+}
+
+bool topology_load_csr(topology_csr_t* csr, const char* filename)
+{
+    topology_csr_init(csr);
+    topology_header_t header;
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("Could not open topology file: %s\n", filename);
+        return false;
+    }
+    size_t read = fread(&header, 1, sizeof(header), file);
+    fclose(file);
+    bool binary = read == sizeof(header) && memcmp(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic)) == 0;
+    bool valid;
+    if (binary && header.format == TOPOLOGY_CSR) {
+        valid = topology_csr_load_binary(csr, filename);
+    } else if (binary) {
+        // a dense file is only read through its (file-backed) mapping while the CSR form is built
+        topology_t topology;
+        valid = topology_load_binary(&topology, filename);
+        if (valid) {
+            valid = topology_csr_from_dense(csr, &topology);
+            topology_free(&topology);
+        }
+    } else {
+        valid = topology_csr_load_text(csr, filename);
+    }
+    if (!valid) {
+        topology_csr_free(csr);
+    }
+    return valid;
+}
+
+bool topology_csr_from_dense(topology_csr_t* csr, const topology_t* topology)
+{
+    size_t n = topology->n;
+    size_t edges = 0;
+    topology_csr_init(csr);
+    if (n > UINT32_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < n * n; i++) {
+        edges += (topology->links[i] != inf_distance);
+    }
+    if (!topology_csr_alloc(csr, n, edges)) {
+        topology_csr_free(csr);
+        return false;
+    }
+    for (size_t src = 0; src < n; src++) {
+        csr->offsets[src] = csr->edges;
+        for (size_t dst = 0; dst < n; dst++) {
+            distance_t weight = topology->links[src * n + dst];
+            if (weight != inf_distance) {
+                csr->neighbors[csr->edges] = (uint32_t)dst;
+                csr->weights[csr->edges] = weight;
+                csr->edges++;
+            }
+        }
+    }
+    csr->offsets[n] = csr->edges;
+    return true;
+}
+
+bool topology_csr_transpose(topology_csr_t* reverse, const topology_csr_t* csr)
+{
+    topology_csr_init(reverse);
+    if (!topology_csr_alloc(reverse, csr->n, csr->edges)) {
+        topology_csr_free(reverse);
+        return false;
+    }
+    // count the links entering each node, then place them; scanning sources in order keeps rows sorted
+    for (size_t dst = 0; dst <= csr->n; dst++) {
+        reverse->offsets[dst] = 0;
+    }
+    for (size_t e = 0; e < csr->edges; e++) {
+        reverse->offsets[csr->neighbors[e] + 1]++;
+    }
+    for (size_t dst = 0; dst < csr->n; dst++) {
+        reverse->offsets[dst + 1] += reverse->offsets[dst];
+    }
+    // offsets[dst] is used as the insertion cursor of row dst and shifted back afterwards
+    for (size_t src = 0; src < csr->n; src++) {
+        for (size_t e = csr->offsets[src]; e < csr->offsets[src + 1]; e++) {
+            size_t slot = reverse->offsets[csr->neighbors[e]]++;
+            reverse->neighbors[slot] = (uint32_t)src;
+            reverse->weights[slot] = csr->weights[e];
+        }
+    }
+    for (size_t dst = csr->n; dst > 0; dst--) {
+        reverse->offsets[dst] = reverse->offsets[dst - 1];
+    }
+    reverse->offsets[0] = 0;
+    reverse->edges = csr->edges;
+    return true;
+}
+
+void topology_csr_to_dense(const topology_csr_t* csr, distance_t* links)
+{
+    for (size_t i = 0; i < csr->n * csr->n; i++) {
+        links[i] = inf_distance;
+    }
+    for (size_t src = 0; src < csr->n; src++) {
+        for (size_t e = csr->offsets[src]; e < csr->offsets[src + 1]; e++) {
+            links[src * csr->n + csr->neighbors[e]] = csr->weights[e];
+        }
+    }
+}
+
+// Expands row src of a CSR topology into row (n entries)
+static void topology_csr_row(const topology_csr_t* csr, size_t src, distance_t* row)
+{
+    for (size_t dst = 0; dst < csr->n; dst++) {
+        row[dst] = inf_distance;
+    }
+    for (size_t e = csr->offsets[src]; e < csr->offsets[src + 1]; e++) {
+        row[csr->neighbors[e]] = csr->weights[e];
+    }
+}
+
+bool topology_csr_save_text(const topology_csr_t* csr, const char* filename)
+{
+    distance_t* row = malloc(sizeof(distance_t) * csr->n);
+    FILE* file = fopen(filename, "w");
+    if (row == NULL || file == NULL) {
+        free(row);
+        if (file != NULL) {
+            fclose(file);
+        }
+        return false;
+    }
+    fprintf(file, "%zu\n", csr->n);
+    for (size_t src = 0; src < csr->n; src++) {
+        topology_csr_row(csr, src, row);
+        for (size_t dst = 0; dst < csr->n; dst++) {
+            if (row[dst] == inf_distance) {
+                fprintf(file, " -1");
+            } else {
+                fprintf(file, " %u", row[dst]);
+            }
+        }
+        fprintf(file, "\n");
+    }
+    free(row);
+    return fclose(file) == 0;
+}
+
+bool topology_csr_save_binary(const topology_csr_t* csr, const char* filename, enum topology_format format)
+{
+    topology_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TOPOLOGY_MAGIC, sizeof(header.magic));
+    header.n = csr->n;
+    header.format = format;
+    header.edges = csr->edges;
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    size_t n = csr->n;
+    bool valid = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (format == TOPOLOGY_DENSE) {
+        distance_t* row = malloc(sizeof(distance_t) * n);
+        valid = valid && row != NULL;
+        for (size_t src = 0; valid && src < n; src++) {
+            topology_csr_row(csr, src, row);
+            valid = fwrite(row, sizeof(distance_t), n, file) == n;
+        }
+        free(row);
+    } else {
+        for (size_t src = 0; valid && src <= n; src++) {
+            uint64_t offset = csr->offsets[src];
+            valid = fwrite(&offset, sizeof(offset), 1, file) == 1;
+        }
+        valid = valid && fwrite(csr->neighbors, sizeof(uint32_t), csr->edges, file) == csr->edges &&
+                fwrite(csr->weights, sizeof(distance_t), csr->edges, file) == csr->edges;
+    }
+    return (fclose(file) == 0) && valid;
+}
+
+distance_t* topology_csr_find(const topology_csr_t* csr, size_t src, size_t dst)
+{
+    // rows are sorted by neighbor, so a binary search finds the link
+    size_t low = csr->offsets[src];
+    size_t high = csr->offsets[src + 1];
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (csr->neighbors[mid] < dst) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < csr->offsets[src + 1] && csr->neighbors[low] == dst) {
+        return &csr->weights[low];
+    }
+    return NULL;
+}
+
+distance_t topology_csr_weight(const topology_csr_t* csr, size_t src, size_t dst)
+{
+    distance_t* weight = topology_csr_find(csr, src, dst);
+    return (weight != NULL) ? *weight : inf_distance;
+}
+
+void topology_csr_free(topology_csr_t* csr)
+{
+    free(csr->offsets);
+    free(csr->neighbors);
+    free(csr->weights);
+    topology_csr_init(csr);
+}
@@ -0,0 +1,94 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "distance.h"
+
+// Binary topology files start with this header
+// A dense file is followed by n * n distance_t link weights (row-major)
+// A CSR file is followed by n + 1 uint64_t row offsets, then edges uint32_t neighbors, then edges distance_t weights
+#define TOPOLOGY_MAGIC "CHTOPO1"
+
+enum topology_format {
+    TOPOLOGY_DENSE = 0,
+    TOPOLOGY_CSR = 1
+};
+
+typedef struct {
+    char magic[8];
+    uint64_t n;
+    uint64_t format;
+    uint64_t edges;
+} topology_header_t;
+
+typedef struct {
+    size_t n;
+    // row-major n x n link weights, inf_distance where there is no link
+    distance_t* links;
+    // non-NULL when links points straight into a mapped dense binary file
+    void* mapping;
+    size_t mapping_size;
+} topology_t;
+
+// Sparse (CSR) view of a topology: the links of node src are
+// neighbors[offsets[src] .. offsets[src + 1]) with matching weights, sorted by neighbor
+// Only links with a finite weight are stored (including a node's link to itself)
+typedef struct {
+    size_t n;
+    size_t edges;
+    size_t* offsets;
+    uint32_t* neighbors;
+    distance_t* weights;
+} topology_csr_t;
+
+// Loads a topology file, detecting the binary format by its magic and falling back to text
+// Returns false (and prints why) if the file cannot be read or is malformed
+bool topology_load(topology_t* topology, const char* filename);
+
+// Parses the text format: the node count followed by n * n integers, negative meaning no link
+bool topology_load_text(topology_t* topology, const char* filename);
+
+// Loads a binary topology; dense files are used in place from a single read-only mapping
+bool topology_load_binary(topology_t* topology, const char* filename);
+
+// Writes the topology in the text format read by topology_load_text
+bool topology_save_text(const topology_t* topology, const char* filename);
+
+// Writes the topology in the given binary format
+bool topology_save_binary(const topology_t* topology, const char* filename, enum topology_format format);
+
+// Releases the memory or mapping behind a loaded topology
+void topology_free(topology_t* topology);
+
+// Loads any topology file straight into CSR form
+// Text and CSR binary files never materialize the n x n matrix
+bool topology_load_csr(topology_csr_t* csr, const char* filename);
+
+// Builds the CSR form of a dense topology
+bool topology_csr_from_dense(topology_csr_t* csr, const topology_t* topology);
+
+// Builds the transpose of a CSR topology, listing the links that enter each node
+bool topology_csr_transpose(topology_csr_t* reverse, const topology_csr_t* csr);
+
+// Writes the n x n dense matrix of a CSR topology into links
+void topology_csr_to_dense(const topology_csr_t* csr, distance_t* links);
+
+// Writes a CSR topology as a text file, expanding one row at a time
+bool topology_csr_save_text(const topology_csr_t* csr, const char* filename);
+
+// Writes a CSR topology as a binary file in the given format, expanding one row at a time for dense files
+bool topology_csr_save_binary(const topology_csr_t* csr, const char* filename, enum topology_format format);
+
+// Returns the stored weight of the link from src to dst so it can be changed in place,
+// or NULL if the CSR form has no entry for that link
+distance_t* topology_csr_find(const topology_csr_t* csr, size_t src, size_t dst);
+
+// Returns the weight of the link from src to dst, or inf_distance if there is none
+distance_t topology_csr_weight(const topology_csr_t* csr, size_t src, size_t dst);
+
+// Releases the memory behind a CSR topology
+void topology_csr_free(topology_csr_t* csr);
+
+#endif // TOPOLOGY_H
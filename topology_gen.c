@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include "topology_gen.h"
+
+static const char* shape_names[] = {"random", "grid", "torus", "ring-of-cliques", "scale-free"};
+
+typedef struct {
+    uint32_t src;
+    uint32_t dst;
+    distance_t weight;
+} gen_edge_t;
+
+typedef struct {
+    const topology_gen_params_t* params;
+    uint64_t rng;
+    gen_edge_t* edges;
+    size_t count;
+    size_t capacity;
+} gen_state_t;
+
+void topology_gen_params_init(topology_gen_params_t* params, enum topology_shape shape, size_t n)
+{
+    params->shape = shape;
+    params->n = n;
+    params->degree = 4;
+    params->min_weight = 1;
+    params->max_weight = 10;
+    params->seed = 1;
+}
+
+bool topology_shape_parse(const char* name, enum topology_shape* shape)
+{
+    for (size_t i = 0; i < sizeof(shape_names) / sizeof(shape_names[0]); i++) {
+        if (strcmp(name, shape_names[i]) == 0) {
+            *shape = (enum topology_shape)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* topology_shape_name(enum topology_shape shape)
+{
+    return shape_names[shape];
+}
+
+// splitmix64: small, fast and identical on every platform
+static uint64_t gen_next(gen_state_t* state)
+{
+    uint64_t z = (state->rng += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static size_t gen_below(gen_state_t* state, size_t bound)
+{
+    return (size_t)(gen_next(state) % bound);
+}
+
+static bool gen_push(gen_state_t* state, size_t src, size_t dst, distance_t weight)
+{
+    if (state->count == state->capacity) {
+        size_t grown = 2 * state->capacity + 64;
+        gen_edge_t* edges = realloc(state->edges, sizeof(gen_edge_t) * grown);
+        if (edges == NULL) {
+            return false;
+        }
+        state->edges = edges;
+        state->capacity = grown;
+    }
+    state->edges[state->count++] = (gen_edge_t){(uint32_t)src, (uint32_t)dst, weight};
+    return true;
+}
+
+// Adds the link between a and b in both directions with one random weight
+static bool gen_link(gen_state_t* state, size_t a, size_t b)
+{
+    if (a == b) {
+        return true;
+    }
+    distance_t span = state->params->max_weight - state->params->min_weight + 1;
+    distance_t weight = state->params->min_weight + (distance_t)gen_below(state, span);
+    return gen_push(state, a, b, weight) && gen_push(state, b, a, weight);
+}
+
+static bool gen_random(gen_state_t* state)
+{
+    size_t n = state->params->n;
+    size_t links = n * state->params->degree / 2;
+    bool valid = true;
+    for (size_t i = 0; valid && n > 1 && i < links; i++) {
+        valid = gen_link(state, gen_below(state, n), gen_below(state, n));
+    }
+    return valid;
+}
+
+static bool gen_grid(gen_state_t* state, bool wrap)
+{
+    size_t n = state->params->n;
+    size_t side = 1;
+    while (side * side < n) {
+        side++;
+    }
+    size_t rows = (n + side - 1) / side;
+    bool valid = true;
+    for (size_t i = 0; valid && i < n; i++) {
+        size_t row = i / side;
+        size_t col = i % side;
+        size_t right = (col + 1 < side) ? i + 1 : (wrap ? row * side : n);
+        size_t down = (row + 1 < rows) ? i + side : (wrap ? col : n);
+        // the last row may be partial, so a link can point past n
+        if (right < n) {
+            valid = gen_link(state, i, right);
+        }
+        if (valid && down < n) {
+            valid = gen_link(state, i, down);
+        }
+    }
+    return valid;
+}
+
+static bool gen_ring_of_cliques(gen_state_t* state)
+{
+    size_t n = state->params->n;
+    size_t size = state->params->degree + 1;
+    size_t cliques = (n + size - 1) / size;
+    bool valid = true;
+    for (size_t c = 0; valid && c < cliques; c++) {
+        size_t first = c * size;
+        size_t last = (first + size < n) ? first + size : n;
+        for (size_t a = first; valid && a < last; a++) {
+            for (size_t b = a + 1; valid && b < last; b++) {
+                valid = gen_link(state, a, b);
+            }
+        }
+        // link the last node of this clique to the first node of the next one
+        if (valid && cliques > 1) {
+            valid = gen_link(state, last - 1, (c + 1 < cliques) ? last : 0);
+        }
+    }
+    return valid;
+}
+
+static bool gen_scale_free(gen_state_t* state)
+{
+    size_t n = state->params->n;
+    size_t m = state->params->degree / 2;
+    if (m == 0) {
+        m = 1;
+    }
+    size_t seed_nodes = (m + 1 < n) ? m + 1 : n;
+    // every link endpoint, so a uniform pick is proportional to degree
+    size_t* ends = malloc(sizeof(size_t) * (2 * (seed_nodes * seed_nodes + n * m) + 1));
+    size_t* targets = malloc(sizeof(size_t) * m);
+    bool valid = ends != NULL && targets != NULL;
+    size_t end_count = 0;
+    for (size_t a = 0; valid && a < seed_nodes; a++) {
+        for (size_t b = a + 1; valid && b < seed_nodes; b++) {
+            valid = gen_link(state, a, b);
+            ends[end_count++] = a;
+            ends[end_count++] = b;
+        }
+    }
+    for (size_t node = seed_nodes; valid && node < n; node++) {
+        size_t picked = 0;
+        while (picked < m && picked < node) {
+            size_t target = (end_count == 0) ? gen_below(state, node) : ends[gen_below(state, end_count)];
+            bool duplicate = false;
+            for (size_t i = 0; i < picked; i++) {
+                duplicate = duplicate || targets[i] == target;
+            }
+            if (!duplicate) {
+                targets[picked++] = target;
+            }
+        }
+        for (size_t i = 0; valid && i < picked; i++) {
+            valid = gen_link(state, node, targets[i]);
+            ends[end_count++] = node;
+            ends[end_count++] = targets[i];
+        }
+    }
+    free(ends);
+    free(targets);
+    return valid;
+}
+
+static int gen_edge_compare(const void* a, const void* b)
+{
+    const gen_edge_t* x = a;
+    const gen_edge_t* y = b;
+    if (x->src != y->src) {
+        return (x->src < y->src) ? -1 : 1;
+    }
+    if (x->dst != y->dst) {
+        return (x->dst < y->dst) ? -1 : 1;
+    }
+    return (x->weight < y->weight) ? -1 : (x->weight > y->weight);
+}
+
+bool topology_generate(topology_csr_t* csr, const topology_gen_params_t* params)
+{
+    memset(csr, 0, sizeof(*csr));
+    if (params->n == 0 || params->n > UINT32_MAX || params->min_weight > params->max_weight ||
+        params->max_weight >= inf_distance) {
+        return false;
+    }
+    gen_state_t state = {params, params->seed, NULL, 0, 0};
+    bool valid;
+    switch (params->shape) {
+    case TOPOLOGY_RANDOM:
+        valid = gen_random(&state);
+        break;
+    case TOPOLOGY_GRID:
+    case TOPOLOGY_TORUS:
+        valid = gen_grid(&state, params->shape == TOPOLOGY_TORUS);
+        break;
+    case TOPOLOGY_RING_OF_CLIQUES:
+        valid = gen_ring_of_cliques(&state);
+        break;
+    case TOPOLOGY_SCALE_FREE:
+        valid = gen_scale_free(&state);
+        break;
+    default:
+        valid = false;
+        break;
+    }
+    // every node reaches itself at no cost
+    for (size_t i = 0; valid && i < params->n; i++) {
+        valid = gen_push(&state, i, i, 0);
+    }
+    if (valid) {
+        // sort by link; of duplicate links only the first (cheapest) one is kept
+        qsort(state.edges, state.count, sizeof(gen_edge_t), gen_edge_compare);
+        csr->n = params->n;
+        csr->offsets = malloc(sizeof(size_t) * (params->n + 1));
+        csr->neighbors = malloc(sizeof(uint32_t) * (state.count + 1));
+        csr->weights = malloc(sizeof(distance_t) * (state.count + 1));
+        valid = csr->offsets != NULL && csr->neighbors != NULL && csr->weights != NULL;
+    }
+    if (valid) {
+        size_t src = 0;
+        for (size_t e = 0; e < state.count; e++) {
+            gen_edge_t* edge = &state.edges[e];
+            if (e > 0 && edge->src == state.edges[e - 1].src && edge->dst == state.edges[e - 1].dst) {
+                continue;
+            }
+            while (src <= edge->src) {
+                csr->offsets[src++] = csr->edges;
+            }
+            csr->neighbors[csr->edges] = edge->dst;
+            csr->weights[csr->edges] = edge->weight;
+            csr->edges++;
+        }
+        while (src <= params->n) {
+            csr->offsets[src++] = csr->edges;
+        }
+    } else {
+        topology_csr_free(csr);
+    }
+    free(state.edges);
+    return valid;
+}
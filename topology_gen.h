@@ -0,0 +1,47 @@
+#ifndef TOPOLOGY_GEN_H
+#define TOPOLOGY_GEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "topology.h"
+
+// Graph families the generator can build
+enum topology_shape {
+    // Erdős–Rényi G(n, m) with m = n * degree / 2 random links
+    TOPOLOGY_RANDOM,
+    // 2D grid on a square-ish layout, every node linked to its right and lower neighbor
+    TOPOLOGY_GRID,
+    // grid whose rows and columns wrap around
+    TOPOLOGY_TORUS,
+    // cliques of degree + 1 nodes, each linked to the next clique to close a ring
+    TOPOLOGY_RING_OF_CLIQUES,
+    // Barabási–Albert preferential attachment, every new node adds degree / 2 links
+    TOPOLOGY_SCALE_FREE,
+};
+
+typedef struct {
+    enum topology_shape shape;
+    size_t n;
+    // average (random, scale-free) or clique (ring of cliques) degree; ignored by grids
+    size_t degree;
+    // link weights are drawn uniformly from [min_weight, max_weight]
+    distance_t min_weight;
+    distance_t max_weight;
+    uint64_t seed;
+} topology_gen_params_t;
+
+// Fills params with the defaults: a random graph of degree 4 with weights 1 to 10 and seed 1
+void topology_gen_params_init(topology_gen_params_t* params, enum topology_shape shape, size_t n);
+
+// Parses a shape name (random, grid, torus, ring-of-cliques, scale-free)
+bool topology_shape_parse(const char* name, enum topology_shape* shape);
+
+// Returns the name of a shape as accepted by topology_shape_parse
+const char* topology_shape_name(enum topology_shape shape);
+
+// Generates an undirected topology (symmetric links, 0 on the diagonal) straight into CSR form
+// The same parameters always produce the same topology
+bool topology_generate(topology_csr_t* csr, const topology_gen_params_t* params);
+
+#endif // TOPOLOGY_GEN_H
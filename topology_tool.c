@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "topology.h"
+#include "topology_gen.h"
+
+// node counts of the benchmark matrix
+static const size_t matrix_sizes[] = {10, 100, 1000, 10000, 100000};
+
+static int usage(const char* program)
+{
+    printf("Usage: %s convert <input> <output> [text|dense|csr]\n", program);
+    printf("  Converts a text or binary topology file; the output format defaults to dense\n");
+    printf("       %s gen <random|grid|torus|ring-of-cliques|scale-free> <nodes> <output>\n", program);
+    printf("           [-d degree] [-w min:max] [-s seed] [-f text|dense|csr]\n");
+    printf("  Generates a reproducible topology; defaults are -d 4 -w 1:10 -s 1 -f csr\n");
+    printf("       %s matrix <directory> [-d degree] [-w min:max] [-s seed] [-f text|dense|csr]\n", program);
+    printf("  Generates every shape with 10 to 100000 nodes as <directory>/<shape>_<nodes>.bin\n");
+    printf("  (<shape>_<nodes>.txt with -f text); the format defaults to csr\n");
+    return 1;
+}
+
+static bool save_csr(const topology_csr_t* csr, const char* output, const char* format)
+{
+    bool saved;
+    if (strcmp(format, "text") == 0) {
+        saved = topology_csr_save_text(csr, output);
+    } else if (strcmp(format, "dense") == 0) {
+        saved = topology_csr_save_binary(csr, output, TOPOLOGY_DENSE);
+    } else if (strcmp(format, "csr") == 0) {
+        saved = topology_csr_save_binary(csr, output, TOPOLOGY_CSR);
+    } else {
+        printf("Unknown format: %s\n", format);
+        return false;
+    }
+    if (!saved) {
+        printf("Could not write topology file: %s\n", output);
+    }
+    return saved;
+}
+
+// Loads the input as CSR, so converting a large sparse topology never builds its n x n matrix
+static int convert(const char* input, const char* output, const char* format)
+{
+    topology_csr_t csr;
+    if (!topology_load_csr(&csr, input)) {
+        return 1;
+    }
+    bool saved = save_csr(&csr, output, format);
+    topology_csr_free(&csr);
+    return saved ? 0 : 1;
+}
+
+// Parses the -d/-w/-s/-f options from argv[first] on
+static bool parse_options(int argc, char** argv, int first, topology_gen_params_t* params, const char** format)
+{
+    for (int i = first; i < argc; i += 2) {
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) {
+            return false;
+        }
+        const char* value = argv[i + 1];
+        char* end;
+        switch (argv[i][1]) {
+        case 'd':
+            params->degree = strtoul(value, &end, 10);
+            break;
+        case 'w':
+            params->min_weight = (distance_t)strtoul(value, &end, 10);
+            if (*end != ':') {
+                return false;
+            }
+            params->max_weight = (distance_t)strtoul(end + 1, &end, 10);
+            break;
+        case 's':
+            params->seed = strtoull(value, &end, 10);
+            break;
+        case 'f':
+            *format = value;
+            continue;
+        default:
+            return false;
+        }
+        if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int generate(int argc, char** argv)
+{
+    enum topology_shape shape;
+    if (!topology_shape_parse(argv[2], &shape)) {
+        printf("Unknown shape: %s\n", argv[2]);
+        return 1;
+    }
+    topology_gen_params_t params;
+    topology_gen_params_init(&params, shape, strtoul(argv[3], NULL, 10));
+    const char* format = "csr";
+    if (!parse_options(argc, argv, 5, &params, &format)) {
+        return usage(argv[0]);
+    }
+    topology_csr_t csr;
+    if (!topology_generate(&csr, &params)) {
+        printf("Could not generate topology\n");
+        return 1;
+    }
+    bool saved = save_csr(&csr, argv[4], format);
+    topology_csr_free(&csr);
+    return saved ? 0 : 1;
+}
+
+static int matrix(int argc, char** argv)
+{
+    topology_gen_params_t params;
+    const char* format = "csr";
+    topology_gen_params_init(&params, TOPOLOGY_RANDOM, 0);
+    if (!parse_options(argc, argv, 3, &params, &format)) {
+        return usage(argv[0]);
+    }
+    // binary formats share one extension, the loaders tell them apart by their header
+    const char* extension = (strcmp(format, "text") == 0) ? "txt" : "bin";
+    mkdir(argv[2], 0755);
+    for (int shape = TOPOLOGY_RANDOM; shape <= TOPOLOGY_SCALE_FREE; shape++) {
+        for (size_t i = 0; i < sizeof(matrix_sizes) / sizeof(matrix_sizes[0]); i++) {
+            params.shape = (enum topology_shape)shape;
+            params.n = matrix_sizes[i];
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s_%zu.%s", argv[2], topology_shape_name(params.shape), params.n, extension);
+            topology_csr_t csr;
+            if (!topology_generate(&csr, &params)) {
+                printf("Could not generate topology: %s\n", path);
+                return 1;
+            }
+            bool saved = save_csr(&csr, path, format);
+            printf("%s: %zu nodes, %zu links\n", path, csr.n, csr.edges);
+            topology_csr_free(&csr);
+            if (!saved) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 4 && argc <= 5 && strcmp(argv[1], "convert") == 0) {
+        return convert(argv[2], argv[3], argc == 5 ? argv[4] : "dense");
+    }
+    if (argc >= 5 && strcmp(argv[1], "gen") == 0) {
+        return generate(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "matrix") == 0) {
+        return matrix(argc, argv);
+    }
+    return usage(argv[0]);
+}